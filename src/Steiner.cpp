@@ -4,10 +4,20 @@
 #include <algorithm>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <numeric>
 #include <cassert>
+#include <climits>
+#include <array>
 #include "util.h"
 #include "Steiner.h"
+#include "parallel.h"
+#include "conflictEngine.h"
+#include "grid.h"
+#include "router.h"
+#include "negotiatedRouter.h"
+#include "spanIndex.h"
 #include <unistd.h>
 
 using namespace std;
@@ -417,125 +427,173 @@ void Steiner::buildRST() {
 
 }
 
-void Steiner::plot(const string &plotName) {
-    string ofileName = plotName;
-    ofstream of(ofileName, ofstream::out);
-    of << "set size ratio -1" << endl;
-    of << "set nokey" << endl;
+template<typename Emit>
+void Steiner::forEachLine(Emit emit) {
+    // an L-shaped edge goes along x at the height of p1, then along y at the x of p2
+    auto edge = [&](const Point &p1, const Point &p2) {
+        if (p1.x != p2.x) emit(false, p1.y, p1.x, p2.x);
+        if (p1.y != p2.y) emit(true, p2.x, p1.y, p2.y);
+    };
+    for (unsigned i = 0; i < _MST.size(); ++i) {
+        if (_edges_del[_MST[i]]) continue;
+        edge(_points[_edges[_MST[i]].p1], _points[_edges[_MST[i]].p2]);
+    }
+    for (unsigned i = 0; i < _newE.size(); ++i) {
+        edge(_points[_newE[i].p1], _points[_newE[i].p2]);
+    }
+}
+
+// one text line of the .out format
+static void write_line(BufferedWriter &of, bool vertical, int fixed, int from, int to) {
+    if (vertical) {
+        of.put("V-line (").put(fixed).put(',').put(from).put(") (").put(fixed).put(',').put(to).put(")\n");
+    } else {
+        of.put("H-line (").put(from).put(',').put(fixed).put(") (").put(to).put(',').put(fixed).put(")\n");
+    }
+}
+
+
+// plot files keep points and segments in gnuplot data blocks, "$name << EOD" up to
+// "EOD", and draw each block with a single plot clause instead of one object apiece
+static void begin_block(BufferedWriter &of, const string &name) {
+    of.put('$').put(name).put(" << EOD\n");
+}
+
+static void end_block(BufferedWriter &of) {
+    of.put("EOD\n");
+}
+
+static void point_row(BufferedWriter &of, int x, int y) {
+    of.put(x).put(' ').put(y).put('\n');
+}
+
+// a segment as its start and the step to its end, for "with vectors"
+static void segment_row(BufferedWriter &of, int x1, int y1, int x2, int y2) {
+    of.put(x1).put(' ').put(y1).put(' ').put(x2 - x1).put(' ').put(y2 - y1).put('\n');
+}
+
+static string segment_clause(const string &name, const string &color, const char *width) {
+    return "$" + name + " using 1:2:3:4 with vectors nohead lc rgb \"" + color + "\" lw " + width;
+}
+
+// pt 7 is a filled circle, size 1 about the radius char 0.3 circles the plots used to draw
+static string point_clause(const string &name, const string &color, const char *size) {
+    return "$" + name + " using 1:2 with points pt 7 ps " + size + " lc rgb \"" + color + "\"";
+}
+
+string Steiner::plotHeader() const {
+    ostringstream of;
+    of << "set size ratio -1" << '\n';
+    of << "set nokey" << '\n';
     of << "set xrange["
        << (_boundaryRight - _boundaryLeft) * -0.05 << ":"
-       << (_boundaryRight - _boundaryLeft) * 1.05 << "]" << endl;
+       << (_boundaryRight - _boundaryLeft) * 1.05 << "]" << '\n';
     of << "set yrange["
        << (_boundaryTop - _boundaryBottom) * -0.05 << ":"
-       << (_boundaryTop - _boundaryBottom) * 1.05 << "]" << endl;
-    int idx = 1;
-    of << "set object " << idx++ << " rect from "
+       << (_boundaryTop - _boundaryBottom) * 1.05 << "]" << '\n';
+    of << "set object " << 1 << " rect from "
        << _boundaryLeft << "," << _boundaryBottom << " to "
        << _boundaryRight << "," << _boundaryTop << "fc rgb \"grey\" behind\n";
+    return of.str();
+}
+
+void Steiner::plot(const string &plotName) {
+    BufferedWriter of(plotName);
+    of.put(plotHeader());
     // point
+    begin_block(of, "pins");
     for (int i = 0; i < _init_p; ++i) {
-        of << "set object circle at first " << _points[i].x << ","
-           << _points[i].y << " radius char 0.3 fillstyle solid "
-           << "fc rgb \"red\" front\n";
+        point_row(of, _points[i].x, _points[i].y);
     }
+    end_block(of);
     // RSG
+    begin_block(of, "rsg");
     for (unsigned i = 0; i < _init_edges.size(); ++i) {
         Point &p1 = _points[_init_edges[i].p1];
         Point &p2 = _points[_init_edges[i].p2];
-        of << "set arrow " << idx++ << " from "
-           << p1.x << "," << p1.y << " to "
-           << p2.x << "," << p2.y
-           << " nohead lc rgb \"white\" lw 1 front\n";
+        segment_row(of, p1.x, p1.y, p2.x, p2.y);
     }
+    end_block(of);
     // MST
+    begin_block(of, "mst");
     for (unsigned i = 0; i < _init_MST.size(); ++i) {
         Point &p1 = _points[_init_edges[_init_MST[i]].p1];
         Point &p2 = _points[_init_edges[_init_MST[i]].p2];
-        of << "set arrow " << idx++ << " from "
-           << p1.x << "," << p1.y << " to "
-           << p2.x << "," << p2.y
-           << " nohead lc rgb \"blue\" lw 1 front\n";
+        segment_row(of, p1.x, p1.y, p2.x, p2.y);
     }
+    end_block(of);
     // s-point
+    begin_block(of, "spoints");
     for (unsigned i = _init_p; i < _points.size(); ++i) {
-        of << "set object circle at first " << _points[i].x << ","
-           << _points[i].y << " radius char 0.3 fillstyle solid "
-           << "fc rgb \"yellow\" front\n";
+        point_row(of, _points[i].x, _points[i].y);
     }
+    end_block(of);
     // RST
-    for (unsigned i = 0; i < _MST.size(); ++i) {
-        if (_edges_del[_MST[i]]) continue;
-        Point &p1 = _points[_edges[_MST[i]].p1];
-        Point &p2 = _points[_edges[_MST[i]].p2];
-        if (p1.x != p2.x) {
-            of << "set arrow " << idx++ << " from "
-               << p1.x << "," << p1.y << " to "
-               << p2.x << "," << p1.y
-               << " nohead lc rgb \"black\" lw 1.5 front\n";
-        }
-        if (p1.y != p2.y) {
-            of << "set arrow " << idx++ << " from "
-               << p2.x << "," << p1.y << " to "
-               << p2.x << "," << p2.y
-               << " nohead lc rgb \"black\" lw 1.5 front\n";
-        }
-    }
-    for (unsigned i = 0; i < _newE.size(); ++i) {
-        of << "set arrow " << idx++ << " from "
-           << _points[_newE[i].p1].x << "," << _points[_newE[i].p1].y << " to "
-           << _points[_newE[i].p2].x << "," << _points[_newE[i].p1].y
-           << " nohead lc rgb \"black\" lw 1.5 front\n";
-        of << "set arrow " << idx++ << " from "
-           << _points[_newE[i].p2].x << "," << _points[_newE[i].p1].y << " to "
-           << _points[_newE[i].p2].x << "," << _points[_newE[i].p2].y
-           << " nohead lc rgb \"black\" lw 1.5 front\n";
-    }
-    of << "plot 1000000000" << endl;
-    of << "pause -1 'Press any key'" << endl;
-    of.close();
+    begin_block(of, "rst");
+    forEachLine([&](bool vertical, int fixed, int from, int to) {
+        if (vertical) segment_row(of, fixed, from, fixed, to);
+        else segment_row(of, from, fixed, to, fixed);
+    });
+    end_block(of);
+    // later clauses are drawn over earlier ones: the trees, then the points on them
+    of.put("plot ").put(segment_clause("rsg", "white", "1")).put(", ").put(segment_clause("mst", "blue", "1"));
+    of.put(", ").put(segment_clause("rst", "black", "1.5"));
+    of.put(", ").put(point_clause("pins", "red", "1")).put(", ").put(point_clause("spoints", "yellow", "1")).put('\n');
+    of.put("pause -1 'Press any key'\n");
 }
 
 void Steiner::outfile(const string &outfileName) {
-    ofstream of(outfileName, ofstream::out);
-    of << "NumRoutedPins = " << _init_p << endl;
-    of << "WireLength = " << _MRST_cost << endl;
-    for (unsigned i = 0; i < _MST.size(); ++i) {
-        if (_edges_del[_MST[i]]) continue;
-        Point &p1 = _points[_edges[_MST[i]].p1];
-        Point &p2 = _points[_edges[_MST[i]].p2];
-        if (p1.x != p2.x) {
-            of << "H-line "
-               << "(" << p1.x << "," << p1.y << ") "
-               << "(" << p2.x << "," << p1.y << ")"
-               << endl;
-        }
-        if (p1.y != p2.y) {
-            of << "V-line "
-               << "(" << p2.x << "," << p1.y << ") "
-               << "(" << p2.x << "," << p2.y << ")"
-               << endl;
-        }
-    }
-    for (unsigned i = 0; i < _newE.size(); ++i) {
-        Point &p1 = _points[_newE[i].p1];
-        Point &p2 = _points[_newE[i].p2];
-        if (p1.x != p2.x) {
-            of << "H-line "
-               << "(" << p1.x << "," << p1.y << ") "
-               << "(" << p2.x << "," << p1.y << ")"
-               << endl;
-        }
-        if (p1.y != p2.y) {
-            of << "V-line "
-               << "(" << p2.x << "," << p1.y << ") "
-               << "(" << p2.x << "," << p2.y << ")"
-               << endl;
-        }
+    BufferedWriter of(outfileName);
+    of.put("NumRoutedPins = ").put(_init_p).put('\n');
+    of.put("WireLength = ").put(_MRST_cost).put('\n');
+    forEachLine([&](bool vertical, int fixed, int from, int to) {
+        write_line(of, vertical, fixed, from, to);
+    });
+}
+
+// binary routes: "SRTB", uint32 version, int64 wirelength, int32 routed pins and uint64
+// line count, then 13 bytes a line: uint8 1 for a V-line and 0 for an H-line, int32 the
+// coordinate it keeps, int32 where it starts and int32 where it ends, in .out order
+static const char ROUTE_MAGIC[4] = {'S', 'R', 'T', 'B'};
+static const uint32_t ROUTE_VERSION = 1;
+
+void Steiner::outfileBinary(const string &outfileName) {
+    uint64_t lines = 0;
+    forEachLine([&](bool, int, int, int) { ++lines; });
+    BufferedWriter of(outfileName, true);
+    int64_t wirelength = _MRST_cost;
+    int32_t pins = _init_p;
+    of.write(ROUTE_MAGIC, 4).write(&ROUTE_VERSION, 4).write(&wirelength, 8).write(&pins, 4).write(&lines, 8);
+    forEachLine([&](bool vertical, int fixed, int from, int to) {
+        char record[13];
+        int32_t coords[3] = {fixed, from, to};
+        record[0] = vertical;
+        memcpy(record + 1, coords, sizeof(coords));
+        of.write(record, sizeof(record));
+    });
+}
+
+bool routes_binary_to_text(const string &binaryName, const string &textName) {
+    ifstream in(binaryName, ios::binary);
+    char magic[4];
+    uint32_t version;
+    int64_t wirelength;
+    int32_t pins;
+    uint64_t lines;
+    in.read(magic, 4).read((char *) &version, 4).read((char *) &wirelength, 8).read((char *) &pins, 4).read((char *) &lines, 8);
+    if (!in || !equal(magic, magic + 4, ROUTE_MAGIC) || version != ROUTE_VERSION) return false;
+    BufferedWriter of(textName);
+    of.put("NumRoutedPins = ").put(pins).put('\n');
+    of.put("WireLength = ").put((long long) wirelength).put('\n');
+    char record[13];
+    for (uint64_t i = 0; i < lines && in.read(record, sizeof(record)); ++i) {
+        int32_t coords[3];
+        memcpy(coords, record + 1, sizeof(coords));
+        write_line(of, record[0] != 0, coords[0], coords[1], coords[2]);
     }
-    of.close();
+    return (bool) in;
 }
 
-//Added Code
 void Steiner::createSteiner(const std::string &fileName, std::vector<Point> Nets, Boundary Bounds) {
     _name = getFileName(fileName, true);
     _boundaryLeft = Bounds.xleft;
@@ -550,64 +608,136 @@ void Steiner::createSteiner(const std::string &fileName, std::vector<Point> Nets
     _init_p = _points.size();
 }
 
-int Steiner::initializeFile(std::ofstream &of) {
-    of << "set size ratio -1" << endl;
-    of << "set nokey" << endl;
-    of << "set xrange["
-       << (_boundaryRight - _boundaryLeft) * -0.05 << ":"
-       << (_boundaryRight - _boundaryLeft) * 1.05 << "]" << endl;
-    of << "set yrange["
-       << (_boundaryTop - _boundaryBottom) * -0.05 << ":"
-       << (_boundaryTop - _boundaryBottom) * 1.05 << "]" << endl;
-    int idx = 1;
-    of << "set object " << idx++ << " rect from "
-       << _boundaryLeft << "," << _boundaryBottom << " to "
-       << _boundaryRight << "," << _boundaryTop << "fc rgb \"grey\" behind\n";
-    return idx;
+void Steiner::plotLOD(const string &plotName, int pixels) {
+    plotLOD(plotName, pixels, Boundary(_boundaryLeft, _boundaryRight, _boundaryBottom, _boundaryTop));
+}
+
+void Steiner::plotLOD(const string &plotName, int pixels, const Boundary &view) {
+    // square pixels of cell board units, the view at most pixels of them a side;
+    // a cell of 1 is full detail
+    int span = max(view.xright - view.xleft, view.ytop - view.ybot) + 1;
+    int cell = max(1, (span + pixels - 1) / max(pixels, 1));
+    int width = (view.xright - view.xleft) / cell + 1;
+    int height = (view.ytop - view.ybot) / cell + 1;
+    auto inView = [&](int x, int y) {
+        return x >= view.xleft && x <= view.xright && y >= view.ybot && y <= view.ytop;
+    };
+    // pins of every pixel
+    Grid<uint32_t> density(width, height);
+    uint32_t densest = 1;
+    for (int i = 0; i < _init_p; ++i) {
+        if (!inView(_points[i].x, _points[i].y)) continue;
+        uint32_t &count = density((_points[i].x - view.xleft) / cell, (_points[i].y - view.ybot) / cell);
+        densest = max(densest, ++count);
+    }
+    // pixels covered by lines along x and along y, each a difference array over its lines
+    Grid<int> rowCover(width + 1, height), colCover(width, height + 1);
+    forEachLine([&](bool vertical, int fixed, int from, int to) {
+        int lo = min(from, to), hi = max(from, to);
+        if (vertical) {
+            if (fixed < view.xleft || fixed > view.xright) return;
+            lo = max(lo, view.ybot), hi = min(hi, view.ytop);
+            if (hi - lo < cell) return;
+            ++colCover((fixed - view.xleft) / cell, (lo - view.ybot) / cell);
+            --colCover((fixed - view.xleft) / cell, (hi - view.ybot) / cell + 1);
+        } else {
+            if (fixed < view.ybot || fixed > view.ytop) return;
+            lo = max(lo, view.xleft), hi = min(hi, view.xright);
+            if (hi - lo < cell) return;
+            ++rowCover((lo - view.xleft) / cell, (fixed - view.ybot) / cell);
+            --rowCover((hi - view.xleft) / cell + 1, (fixed - view.ybot) / cell);
+        }
+    });
+    // centre of a pixel on the board
+    auto atX = [&](int px) { return view.xleft + px * cell + cell / 2; };
+    auto atY = [&](int py) { return view.ybot + py * cell + cell / 2; };
+
+    BufferedWriter of(plotName);
+    of.put("set size ratio -1\n");
+    of.put("set nokey\n");
+    of.put("set xrange[").put(view.xleft).put(':').put(view.xright).put("]\n");
+    of.put("set yrange[").put(view.ybot).put(':').put(view.ytop).put("]\n");
+    of.put("set object 1 rect from ").put(_boundaryLeft).put(',').put(_boundaryBottom).put(" to ")
+      .put(_boundaryRight).put(',').put(_boundaryTop).put(" fc rgb \"grey\" behind\n");
+    of.put("set cbrange[1:").put((long long) densest).put("]\n");
+    of.put("set cblabel 'pins per ").put(cell).put('x').put(cell).put("'\n");
+    of.put("set palette defined (0 \"yellow\", 1 \"red\")\n");
+    begin_block(of, "pins");
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (density(x, y)) of.put(atX(x)).put(' ').put(atY(y)).put(' ').put((long long) density(x, y)).put('\n');
+        }
+    }
+    end_block(of);
+    // every run of covered pixels is one line from the centre of its first pixel to that of its last
+    begin_block(of, "rst");
+    for (int y = 0; y < height; ++y) {
+        int cover = 0;
+        for (int x = 0, start = 0; x < width; ++x) {
+            if (!cover && rowCover(x, y) > 0) start = x;
+            cover += rowCover(x, y);
+            if (cover && !(cover + rowCover(x + 1, y))) segment_row(of, atX(start), atY(y), atX(x), atY(y));
+        }
+    }
+    for (int x = 0; x < width; ++x) {
+        int cover = 0;
+        for (int y = 0, start = 0; y < height; ++y) {
+            if (!cover && colCover(x, y) > 0) start = y;
+            cover += colCover(x, y);
+            if (cover && !(cover + colCover(x, y + 1))) segment_row(of, atX(x), atY(start), atX(x), atY(y));
+        }
+    }
+    end_block(of);
+    of.put("plot ").put(segment_clause("rst", "black", "1"));
+    of.put(", $pins using 1:2:3 with points pt 5 ps 0.5 lc palette\n");
+    of.put("pause -1 'Press any key'\n");
+}
+
+// the clauses of a file shared by several nets gather in two gnuplot strings, so that
+// every net's segments stay behind every net's points; finishFile plots them
+int Steiner::initializeFile(std::ofstream &file) {
+    BufferedWriter of(file);
+    of.put(plotHeader());
+    of.put("BACK = '1000000000 notitle'\n");
+    of.put("FRONT = ''\n");
+    return 2;
+}
+
+void Steiner::finishFile(std::ofstream &file) {
+    BufferedWriter of(file);
+    of.put("eval 'plot ' . BACK . FRONT\n");
+    of.put("pause -1 'Press any key'\n");
+}
+
+static void add_clause(BufferedWriter &of, const char *layer, const string &clause) {
+    of.put(layer).put(" = ").put(layer).put(" . ', ").put(clause).put("'\n");
 }
 
 int Steiner::plotMultiple(std::ofstream &file, int idx, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList,
                           std::vector<std::vector<Point>> &nodeList, std::string color) {
+    BufferedWriter of(file);
+    string pins = "pins" + to_string(idx), spoints = "spoints" + to_string(idx), segs = "segs" + to_string(idx);
     // point
+    begin_block(of, pins);
     for (int i = 0; i < _init_p; ++i) {
-
-        file << "set object circle at first " << _points[i].x << ","
-             << _points[i].y << " radius char 0.3 fillstyle solid "
-             << "fc rgb \"black\" front\n";
-        file << "set object circle at first " << _points[i].x << ","
-             << _points[i].y << " radius char 0.15 fillstyle solid "
-             << "fc rgb \""
-             << color
-             << "\" front\n";
-    }
-    // RSG
-    for (unsigned i = 0; i < _init_edges.size(); ++i) {
-        Point &p1 = _points[_init_edges[i].p1];
-        Point &p2 = _points[_init_edges[i].p2];
-        // file << "set arrow " << idx++ << " from "
-        // << p1.x << "," << p1.y << " to "
-        // << p2.x << "," << p2.y
-        // << " nohead lc rgb \"white\" lw 1 front\n";
-    }
-    // MST
-    for (unsigned i = 0; i < _init_MST.size(); ++i) {
-        Point &p1 = _points[_init_edges[_init_MST[i]].p1];
-        Point &p2 = _points[_init_edges[_init_MST[i]].p2];
-        // file << "set arrow " << idx++ << " from "
-        // << p1.x << "," << p1.y << " to "
-        // << p2.x << "," << p2.y
-        // << " nohead lc rgb \"blue\" lw 1 front\n";
+        point_row(of, _points[i].x, _points[i].y);
     }
+    end_block(of);
+    // black rim, then the net colour
+    add_clause(of, "FRONT", point_clause(pins, "black", "1"));
+    add_clause(of, "FRONT", point_clause(pins, color, "0.5"));
     std::vector<Point> tempNodes;
     // s-point
+    begin_block(of, spoints);
     for (unsigned i = _init_p; i < _points.size(); ++i) {
         tempNodes.push_back(_points.at(i));
-        file << "set object circle at first " << _points[i].x << ","
-             << _points[i].y << " radius char 0.3 fillstyle solid "
-             << "fc rgb \"yellow\" front\n";
+        point_row(of, _points[i].x, _points[i].y);
     }
+    end_block(of);
+    add_clause(of, "FRONT", point_clause(spoints, "yellow", "1"));
     std::vector<std::vector<int>> tempSpace;
     // RST
+    begin_block(of, segs);
     for (unsigned i = 0; i < _MST.size(); ++i) {
         //if (_edges_del[_MST[i]]) continue;
         Point &p1 = _points[_edges[_MST[i]].p1];
@@ -617,12 +747,7 @@ int Steiner::plotMultiple(std::ofstream &file, int idx, std::vector<std::vector<
         if (p1.x != p2.x) {
             leftRightShift = true;
             std::vector<int> tempHEdge;
-            file << "set arrow " << idx++ << " from "
-                 << p1.x << "," << p1.y << " to "
-                 << p2.x << "," << p1.y
-                 << " nohead lc rgb \""
-                 << color
-                 << "\" lw 1.5 back\n";
+            segment_row(of, p1.x, p1.y, p2.x, p1.y);
             //checkEdges << "H " << p1.y << " " << p1.x << " " << p2.x << std::endl;
 
             if (p1.x < p2.x) {
@@ -641,12 +766,7 @@ int Steiner::plotMultiple(std::ofstream &file, int idx, std::vector<std::vector<
         if (p1.y != p2.y) {
             topDownShift = true;
             std::vector<int> tempVEdge;
-            file << "set arrow " << idx++ << " from "
-                 << p2.x << "," << p1.y << " to "
-                 << p2.x << "," << p2.y
-                 << " nohead lc rgb \""
-                 << color
-                 << "\" lw 1.5 back\n";
+            segment_row(of, p2.x, p1.y, p2.x, p2.y);
             // checkEdges << "V " << p2.x << " " << p1.y << " " << p2.y << std::endl;
 
             if (p1.y < p2.y) {
@@ -667,11 +787,13 @@ int Steiner::plotMultiple(std::ofstream &file, int idx, std::vector<std::vector<
             tempNodes.push_back(tempP);
         }
     }
+    end_block(of);
+    add_clause(of, "BACK", segment_clause(segs, color, "1.5"));
     nodeList.push_back(tempNodes);
     std::vector<std::vector<std::vector<int>>> tempNet;
     tempNet.push_back(tempSpace);
     edgeList.push_back(tempNet);
-    return idx;
+    return idx + 1;
 }
 
 std::vector<Point> Steiner::getPoints() {
@@ -686,8 +808,146 @@ std::vector<int> Steiner::getMST() {
 std::vector<bool> Steiner::getEdges_del() {
     return _edges_del;
 }    //neeeds a getter
-void checkNets(std::ofstream &file, std::vector<Reroute> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList) {
+// true when segment s of one net crosses segment t of another net,
+// collinear overlaps are ignored the same way checkNets always did
+static bool segmentsConflict(const std::vector<int> &s, const std::vector<int> &t) {
+    int x1 = s[0], y1 = s[1], x2 = s[2], y2 = s[3];
+    int sampleX1 = t[0], sampleY1 = t[1], sampleX2 = t[2], sampleY2 = t[3];
+    if (((x1 == x2) & (sampleX1 == sampleX2) & (x1 == sampleX1)) & (((y1 >= sampleY1) & (y2 <= sampleY2)) | ((sampleY1 >= y1) & (sampleY2 <= y2)))) {
+        return false;
+    } else if (((y1 == y2) & (sampleY1 == sampleY2) & (y1 == sampleY1)) & (((x1 >= sampleX1) & (x2 <= sampleX2)) | ((sampleX1 >= x1) & (sampleX2 <= x2)))) {
+        return false;
+    }
+    return ((sampleX1 >= x1) & (sampleX2 <= x2) & (y1 >= sampleY1) & (y2 <= sampleY2)) | ((x1 >= sampleX1) & (x2 <= sampleX2) & (sampleY1 >= y1) & (sampleY2 <= y2));
+}
+
+// segment of net a -> nets (ascending, > a) holding a segment it crosses
+typedef std::map<std::vector<int>, std::vector<int>> ConflictCandidates;
+
+// true when segment n of a space is taken along with segment m of it on a regrouping:
+// both on one line and overlapping, or crossing, T and corner joints included
+static bool segmentsTouch(const std::vector<int> &m, const std::vector<int> &n) {
+    int mX1 = m[0], mY1 = m[1], mX2 = m[2], mY2 = m[3];
+    int nX1 = n[0], nY1 = n[1], nX2 = n[2], nY2 = n[3];
+    return (((mX1 == mX2) & (nX1 == nX2) & (mX1 == nX1)) & (((mY2 >= nY1) & (mY2 <= nY2)) | ((nY2 >= mY1) & (nY2 <= mY2)))) |
+           (((mY1 == mY2) & (nY1 == nY2) & (mY1 == nY1)) & (((mX2 >= nX1) & (mX2 <= nX2)) | ((nX2 >= mX1) & (nX2 <= mX2)))) |
+           ((nX1 >= mX1) & (nX2 <= mX2) & (mY1 >= nY1) & (mY2 <= nY2)) | ((mX1 >= nX1) & (mX2 <= nX2) & (nY1 >= mY1) & (nY2 <= mY2));
+}
+
+// moved segments looked for by rescanning the space before splitAt sorts it
+static const int SPLIT_RESCANS = 16;
+
+// segments of one direction by the line they are on, sorted along it,
+// to find the ones reaching into a box without going over whole lines
+class LineSegments {
+public:
+    void add(int line, int from, int to, int id) {
+        _runs.push_back({line, min(from, to), max(from, to), id});
+    }
+
+    void build() {
+        sort(_runs.begin(), _runs.end());
+        _reach.resize(_runs.size());
+        for (size_t r = 0; r < _runs.size(); r++) {
+            bool sameLine = r > 0 && _runs[r - 1][0] == _runs[r][0];
+            _reach[r] = sameLine ? max(_reach[r - 1], _runs[r][2]) : _runs[r][2];
+        }
+    }
+
+    // emit(id) for every segment on a line in [lineLo, lineHi] overlapping [lo, hi] along it, and a few more
+    template<typename Emit>
+    void visit(int lineLo, int lineHi, int lo, int hi, Emit emit) const {
+        typedef std::array<int, 4> Run;
+        auto it = lower_bound(_runs.begin(), _runs.end(), Run{lineLo, INT_MIN, INT_MIN, INT_MIN});
+        while (it != _runs.end() && (*it)[0] <= lineHi) {
+            int line = (*it)[0];
+            auto next = upper_bound(it, _runs.end(), Run{line, INT_MAX, INT_MAX, INT_MAX});
+            // the runs starting up to hi, back to where none before reaches lo
+            auto last = upper_bound(it, next, Run{line, hi, INT_MAX, INT_MAX});
+            for (auto r = last; r != it && _reach[r - 1 - _runs.begin()] >= lo; --r) emit((*(r - 1))[3]);
+            it = next;
+        }
+    }
+
+private:
+    std::vector<std::array<int, 4>> _runs; // line, from, to, id
+    std::vector<int> _reach;               // the furthest to of the runs so far on the line
+};
+
+// takes segment pos out of space j of net, and moves the segments joined to its far endpoint,
+// directly or through each other, to a new space at the end of net headed by that endpoint.
+// They go in the order a rescan of the space per moved segment would take them; the rest of
+// the space keeps its order. Returns the index to go on from, the one before pos as it is now
+static int splitAt(std::vector<std::vector<std::vector<int>>> &net, int j, int pos) {
+    std::vector<std::vector<int>> &space = net[j];
+    std::vector<int> seed = {space[pos][2], space[pos][3], space[pos][2], space[pos][3]};
+    space.erase(space.begin() + pos);
+    int n = space.size();
+    std::vector<bool> taken(n, false);
+    std::vector<int> found;
+    auto take = [&](const std::vector<int> &m, int s) {
+        if (!taken[s] && segmentsTouch(m, space[s])) {
+            taken[s] = true;
+            found.push_back(s);
+        }
+    };
+    // a segment touching m lies in the box of m; a single point is in both directions,
+    // anything neither along a row nor a column is checked every time
+    LineSegments rows, cols;
+    std::vector<int> other;
+    std::vector<std::vector<int>> moved;
+    moved.push_back(seed);
+    int movedBefore = 0;
+    for (int m = 0; m < moved.size(); m++) {
+        std::vector<int> segment = moved[m];
+        found.clear();
+        if (m < SPLIT_RESCANS) {
+            for (int s = 0; s < n; s++) take(segment, s);
+        } else {
+            if (m == SPLIT_RESCANS) {
+                for (int s = 0; s < n; s++) {
+                    if (taken[s]) continue;
+                    const std::vector<int> &g = space[s];
+                    if (g[1] == g[3]) rows.add(g[1], g[0], g[2], s);
+                    if (g[0] == g[2]) cols.add(g[0], g[1], g[3], s);
+                    if (g[1] != g[3] && g[0] != g[2]) other.push_back(s);
+                }
+                rows.build();
+                cols.build();
+            }
+            int xLo = min(segment[0], segment[2]), xHi = max(segment[0], segment[2]);
+            int yLo = min(segment[1], segment[3]), yHi = max(segment[1], segment[3]);
+            rows.visit(yLo, yHi, xLo, xHi, [&](int s) { take(segment, s); });
+            cols.visit(xLo, xHi, yLo, yHi, [&](int s) { take(segment, s); });
+            for (int s: other) take(segment, s);
+            sort(found.begin(), found.end());
+        }
+        for (int s: found) {
+            moved.push_back(space[s]);
+            if (s < pos) movedBefore++;
+        }
+    }
+    if (moved.size() > 1) {
+        int kept = 0;
+        for (int s = 0; s < n; s++) {
+            if (!taken[s]) space[kept++].swap(space[s]);
+        }
+        space.resize(kept);
+    }
+    net.push_back(moved);
+    return pos - 1 - movedBefore;
+}
+
+// the conflict search and regrouping shared by checkNets and checkNetsParallel,
+// with candidates == nullptr every later net is scanned for every segment,
+// otherwise only the nets listed for the segment are, which is enough since
+// only segments that crossed before regrouping can cross during it
+static void resolveConflicts(std::ofstream &file, std::vector<Reroute> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList,
+                             const std::vector<ConflictCandidates> *candidates) {
+    const std::vector<int> noNets;
     for (int a = 0; a < edgeList.size(); a++) {
+        std::vector<int> laterNets;
+        for (int i = a + 1; i < edgeList.size(); i++) laterNets.push_back(i);
         for (int b = 0; b < edgeList[a].size(); b++) {
             for (int c = 0; c < edgeList[a][b].size(); c++) {
                 bool cDecrement = false;
@@ -695,201 +955,134 @@ void checkNets(std::ofstream &file, std::vector<Reroute> &errors, std::vector<st
                 int y1 = edgeList[a][b][c].at(1);
                 int x2 = edgeList[a][b][c].at(2);
                 int y2 = edgeList[a][b][c].at(3);
-                for (int i = a; i < edgeList.size(); i++) {
-                    if (a != i) {
-                        for (int j = 0; j < edgeList[i].size(); j++) {
-                            for (int k = 0; k < edgeList[i][j].size(); k++) {
-                                int sampleX1 = edgeList[i][j][k].at(0);
-                                int sampleY1 = edgeList[i][j][k].at(1);
-                                int sampleX2 = edgeList[i][j][k].at(2);
-                                int sampleY2 = edgeList[i][j][k].at(3);
-                                if (((x1 == x2) & (sampleX1 == sampleX2) & (x1 == sampleX1)) & (((y1 >= sampleY1) & (y2 <= sampleY2)) | ((sampleY1 >= y1) & (sampleY2 <= y2)))) {
-                                } else if (((y1 == y2) & (sampleY1 == sampleY2) & (y1 == sampleY1)) & (((x1 >= sampleX1) & (x2 <= sampleX2)) | ((sampleX1 >= x1) & (sampleX2 <= x2)))) {
-                                } else if (((sampleX1 >= x1) & (sampleX2 <= x2) & (y1 >= sampleY1) & (y2 <= sampleY2)) | ((x1 >= sampleX1) & (x2 <= sampleX2) & (sampleY1 >= y1) & (sampleY2 <= y2))) {
-                                    if (x1 == x2) {
-                                        file << "set object circle at first " << x1 << ","
-                                             << sampleY1 << " radius char 0.3 fillstyle solid "
-                                             << "fc rgb \"red\" front\n";
-                                        Reroute tempVerror = Reroute{a, i, x1, sampleY1};
-                                        errors.push_back(tempVerror);
-
-                                    } else if (y1 == y2) {
-                                        file << "set object circle at first " << sampleX1 << ","
-                                             << y1 << " radius char 0.3 fillstyle solid "
-                                             << "fc rgb \"red\" front\n";
-                                        Reroute tempHerror = Reroute{i, a, sampleX1, y1};
-                                        errors.push_back(tempHerror);
-                                    }
-                                    std::vector<std::vector<int>> moveSpace;
-                                    moveSpace.push_back({sampleX2, sampleY2, sampleX2, sampleY2});
-                                    edgeList[i][j].erase(edgeList[i][j].begin() + k);
-                                    k--;
-                                    int movedEdges = 0;
-                                    for (int m = 0; m < moveSpace.size(); m++) {
-                                        int mX1 = moveSpace[m].at(0);
-                                        int mY1 = moveSpace[m].at(1);
-                                        int mX2 = moveSpace[m].at(2);
-                                        int mY2 = moveSpace[m].at(3);
-                                        for (int n = 0; n < edgeList[i][j].size(); n++) {
-                                            int nX1 = edgeList[i][j][n].at(0);
-                                            int nY1 = edgeList[i][j][n].at(1);
-                                            int nX2 = edgeList[i][j][n].at(2);
-                                            int nY2 = edgeList[i][j][n].at(3);
-                                            if (((mX1 == mX2) & (nX1 == nX2) & (mX1 == nX1)) & (((mY2 >= nY1) & (mY2 <= nY2)) | ((nY2 >= mY1) & (nY2 <= mY2)))) {
-                                                moveSpace.push_back(edgeList[i][j].at(n));
-                                                edgeList[i][j].erase(edgeList[i][j].begin() + n);
-                                                if (n <= k) {
-                                                    k--;
-                                                    movedEdges++;
-                                                }
-                                                n--;
-                                            } else if (((mY1 == mY2) & (nY1 == nY2) & (mY1 == nY1)) & (((mX2 >= nX1) & (mX2 <= nX2)) | ((nX2 >= mX1) & (nX2 <= mX2)))) {
-                                                moveSpace.push_back(edgeList[i][j].at(n));
-                                                edgeList[i][j].erase(edgeList[i][j].begin() + n);
-                                                if (n <= k) {
-                                                    k--;
-                                                    movedEdges++;
-                                                }
-                                                n--;
-                                            } else if (((nX1 >= mX1) & (nX2 <= mX2) & (mY1 >= nY1) & (mY2 <= nY2)) | ((mX1 >= nX1) & (mX2 <= nX2) & (nY1 >= mY1) & (nY2 <= mY2))) {
-                                                moveSpace.push_back(edgeList[i][j].at(n));
-                                                edgeList[i][j].erase(edgeList[i][j].begin() + n);
-                                                // std::cout << "inside 6 deep for loop" << j << std::endl;
-                                                if (n <= k) {
-                                                    k--;
-                                                    movedEdges++;
-                                                }
-                                                n--;
-                                            }
-                                        }
-                                    }
-                                    edgeList[i].push_back(moveSpace);
-                                    cDecrement = true;
-                                    // std::vector<Reroute> temp;
-                                    // Reroute left = Reroute(a, 0, j, xAxis, xMin, xMax, yAxis, yAxis);
-                                    // Reroute right = Reroute(a, 0, j, xAxis, xMax, xMin, yAxis, yAxis);
-                                    // Reroute bottom = Reroute(j, 1, a, yAxis, yMin, yMax, xAxis, xAxis);
-                                    // Reroute top = Reroute(j, 1, a, yAxis, yMax, yMin, xAxis, xAxis);
-                                    // found = 1;
-                                    // temp.push_back(left);
-                                    // temp.push_back(right);
-                                    // temp.push_back(bottom);
-                                    // temp.push_back(top);
-                                    // errors.push_back(temp);
-                                    // vertical[j].erase(vertical[j].begin() + k);
-
+                const std::vector<int> *nets = &laterNets;
+                if (candidates) {
+                    auto it = (*candidates)[a].find(edgeList[a][b][c]);
+                    nets = it == (*candidates)[a].end() ? &noNets : &it->second;
+                }
+                for (int i: *nets) {
+                    for (int j = 0; j < edgeList[i].size(); j++) {
+                        for (int k = 0; k < edgeList[i][j].size(); k++) {
+                            int sampleX1 = edgeList[i][j][k].at(0);
+                            int sampleY1 = edgeList[i][j][k].at(1);
+                            if (segmentsConflict(edgeList[a][b][c], edgeList[i][j][k])) {
+                                if (x1 == x2) {
+                                    file << "set object circle at first " << x1 << ","
+                                         << sampleY1 << " radius char 0.3 fillstyle solid "
+                                         << "fc rgb \"red\" front\n";
+                                    Reroute tempVerror = Reroute{a, i, x1, sampleY1};
+                                    errors.push_back(tempVerror);
+
+                                } else if (y1 == y2) {
+                                    file << "set object circle at first " << sampleX1 << ","
+                                         << y1 << " radius char 0.3 fillstyle solid "
+                                         << "fc rgb \"red\" front\n";
+                                    Reroute tempHerror = Reroute{i, a, sampleX1, y1};
+                                    errors.push_back(tempHerror);
                                 }
+                                k = splitAt(edgeList[i], j, k);
+                                cDecrement = true;
                             }
                         }
                     }
                 }
                 if (cDecrement) {
-                    std::vector<std::vector<int>> moveSpaceSlow;
-                    moveSpaceSlow.push_back({x2, y2, x2, y2});
-                    edgeList[a][b].erase(edgeList[a][b].begin() + c);
-                    c--;
-                    int movedEdges = 0;
-                    for (int e = 0; e < moveSpaceSlow.size(); e++) {
-                        int eX1 = moveSpaceSlow[e].at(0);
-                        int eY1 = moveSpaceSlow[e].at(1);
-                        int eX2 = moveSpaceSlow[e].at(2);
-                        int eY2 = moveSpaceSlow[e].at(3);
-                        for (int f = 0; f < edgeList[a][b].size(); f++) {
-                            int fX1 = edgeList[a][b][f].at(0);
-                            int fY1 = edgeList[a][b][f].at(1);
-                            int fX2 = edgeList[a][b][f].at(2);
-                            int fY2 = edgeList[a][b][f].at(3);
-                            if (((eX1 == eX2) & (fX1 == fX2) & (eX1 == fX1)) & (((eY2 >= fY1) & (eY2 <= fY2)) | ((fY2 >= eY1) & (fY2 <= eY2)))) {
-                                moveSpaceSlow.push_back(edgeList[a][b].at(f));
-                                edgeList[a][b].erase(edgeList[a][b].begin() + f);
-                                if (f <= c) {
-                                    c--;
-                                    movedEdges++;
-                                }
-                                f--;
-                            } else if (((eY1 == eY2) & (fY1 == fY2) & (eY1 == fY1)) & (((eX2 >= fX1) & (eX2 <= fX2)) | ((fX2 >= eX1) & (fX2 <= eX2)))) {
-                                moveSpaceSlow.push_back(edgeList[a][b].at(f));
-                                edgeList[a][b].erase(edgeList[a][b].begin() + f);
-                                if (f <= c) {
-                                    c--;
-                                    movedEdges++;
-                                }
-                                f--;
-                            } else if (((fX1 >= eX1) & (fX2 <= eX2) & (eY1 >= fY1) & (eY2 <= fY2)) | ((eX1 >= fX1) & (eX2 <= fX2) & (fY1 >= eY1) & (fY2 <= eY2))) {
-                                // std::cout << "moveSpaceSlow: " << moveSpaceSlow.size() << std::endl;
-                                moveSpaceSlow.push_back(edgeList[a][b].at(f));
-                                // std::cout << "moveSpaceSlow: " << moveSpaceSlow.size() << std::endl;
-                                edgeList[a][b].erase(edgeList[a][b].begin() + f);
-                                // std::cout << "inside 6 not so deep for loop" << std::endl;
-                                if (f <= c) {
-                                    c--;
-                                    movedEdges++;
-                                }
-                                f--;
-                            }
-                        }
-                    }
-                    edgeList[a].push_back(moveSpaceSlow);
+                    c = splitAt(edgeList[a], b, c);
                 }
-                // std::cout << c <<std::endl;
             }
         }
     }
 }
 
-int Steiner::plotFixed(std::ofstream &file, int idx, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList, std::vector<std::string> color, int initialColor) {
-    // point
-    for (int i = 0; i < _init_p; ++i) {
+void checkNets(std::ofstream &file, std::vector<Reroute> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList) {
+    resolveConflicts(file, errors, edgeList, nullptr);
+}
 
-        file << "set object circle at first " << _points[i].x << ","
-             << _points[i].y << " radius char 0.3 fillstyle solid "
-             << "fc rgb \"black\" front\n";
-        file << "set object circle at first " << _points[i].x << ","
-             << _points[i].y << " radius char 0.15 fillstyle solid "
-             << "fc rgb \""
-             << color.at(initialColor)
-             << "\" front\n";
+void checkNetsParallel(std::ofstream &file, std::vector<Reroute> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList, unsigned numThreads) {
+    if (numThreads == 0) numThreads = defaultThreadCount();
+    int numNets = edgeList.size();
+    // flatten every net once, the detection pass only reads these
+    std::vector<std::vector<const std::vector<int> *>> segments(numNets);
+    for (int a = 0; a < numNets; a++) {
+        for (auto &space: edgeList[a]) {
+            for (auto &seg: space) segments[a].push_back(&seg);
+        }
     }
-    // RSG
-    for (unsigned i = 0; i < _init_edges.size(); ++i) {
-        Point &p1 = _points[_init_edges[i].p1];
-        Point &p2 = _points[_init_edges[i].p2];
-        // file << "set arrow " << idx++ << " from "
-        // << p1.x << "," << p1.y << " to "
-        // << p2.x << "," << p2.y
-        // << " nohead lc rgb \"white\" lw 1 front\n";
+    std::vector<std::pair<int, int>> pairs;
+    for (int a = 0; a < numNets; a++) {
+        for (int i = a + 1; i < numNets; i++) pairs.emplace_back(a, i);
     }
-    // MST
-    for (unsigned i = 0; i < _init_MST.size(); ++i) {
-        Point &p1 = _points[_init_edges[_init_MST[i]].p1];
-        Point &p2 = _points[_init_edges[_init_MST[i]].p2];
-        // file << "set arrow " << idx++ << " from "
-        // << p1.x << "," << p1.y << " to "
-        // << p2.x << "," << p2.y
-        // << " nohead lc rgb \"blue\" lw 1 front\n";
+    // detect crossings of every net pair concurrently, one buffer per thread
+    std::vector<std::vector<std::tuple<int, int, int>>> found(numThreads); // a, segment of a, i
+    parallelFor(pairs.size(), numThreads, [&](int t, unsigned worker) {
+        int a = pairs[t].first;
+        int i = pairs[t].second;
+        for (int c = 0; c < segments[a].size(); c++) {
+            for (auto seg: segments[i]) {
+                if (segmentsConflict(*segments[a][c], *seg)) {
+                    found[worker].emplace_back(a, c, i);
+                    break;
+                }
+            }
+        }
+    });
+    std::vector<ConflictCandidates> candidates(numNets);
+    for (auto &buffer: found) {
+        for (auto &hit: buffer) {
+            int a = get<0>(hit);
+            candidates[a][*segments[a][get<1>(hit)]].push_back(get<2>(hit));
+        }
     }
-    // s-point
-    for (unsigned i = _init_p; i < _points.size(); ++i) {
-        // file << "set object circle at first " << _points[i].x << ","
-        // << _points[i].y << " radius char 0.3 fillstyle solid "
-        // << "fc rgb \"yellow\" front\n";
+    for (auto &netCandidates: candidates) {
+        for (auto &entry: netCandidates) {
+            sort(entry.second.begin(), entry.second.end());
+            entry.second.erase(unique(entry.second.begin(), entry.second.end()), entry.second.end());
+        }
     }
-    // RST
+    // regroup sequentially in the same order checkNets walks the nets
+    resolveConflicts(file, errors, edgeList, &candidates);
+}
+
+int Steiner::plotFixed(std::ofstream &file, int idx, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList, std::vector<std::string> color, int initialColor) {
+    BufferedWriter of(file);
+    string pins = "pins" + to_string(idx);
+    // point
+    begin_block(of, pins);
+    for (int i = 0; i < _init_p; ++i) {
+        point_row(of, _points[i].x, _points[i].y);
+    }
+    end_block(of);
+    add_clause(of, "FRONT", point_clause(pins, "black", "1"));
+    add_clause(of, "FRONT", point_clause(pins, color.at(initialColor), "0.5"));
+    // RST, every space in the colour of its index; the spaces go in net order, one block
+    // per run of spaces in the same colour, so later spaces are still drawn over earlier ones
     if (!initialColor) {
+        int blocks = 0, open = -1;
+        string segs;
         for (int i = 0; i < edgeList.size(); i++) {
             for (int j = 0; j < edgeList[i].size(); j++) {
+                if (edgeList[i][j].empty()) continue;
+                int c = j % color.size();
+                if (c != open) {
+                    if (open >= 0) {
+                        end_block(of);
+                        add_clause(of, "BACK", segment_clause(segs, color.at(open), "1.5"));
+                    }
+                    segs = "segs" + to_string(idx) + "_" + to_string(blocks++);
+                    begin_block(of, segs);
+                    open = c;
+                }
                 for (int k = 0; k < edgeList[i][j].size(); k++) {
-                    file << "set arrow " << idx++ << " from "
-                         << edgeList[i][j][k].at(0) << "," << edgeList[i][j][k].at(1) << " to "
-                         << edgeList[i][j][k].at(2) << "," << edgeList[i][j][k].at(3)
-                         << " nohead lc rgb \""
-                         << color.at(j % color.size())
-                         << "\" lw 1.5 back\n";
+                    segment_row(of, edgeList[i][j][k].at(0), edgeList[i][j][k].at(1), edgeList[i][j][k].at(2), edgeList[i][j][k].at(3));
                 }
             }
         }
+        if (open >= 0) {
+            end_block(of);
+            add_clause(of, "BACK", segment_clause(segs, color.at(open), "1.5"));
+        }
     }
-    return idx;
+    return idx + 1;
 }
 
 // void Steiner::createGrid(std::ofstream &file, int spacing)
@@ -906,85 +1099,59 @@ int Steiner::plotFixed(std::ofstream &file, int idx, std::vector<std::vector<std
 // }
 // }
 void Steiner::cleanNetlist(std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList, int steinerNum) {
-    for (int i = 0; i < edgeList[steinerNum].size(); i++) {
-        for (int j = 0; j < edgeList[steinerNum][i].size(); j++) {
-            if ((edgeList[steinerNum][i][j].at(0) == edgeList[steinerNum][i][j].at(2)) & (edgeList[steinerNum][i][j].at(1) == edgeList[steinerNum][i][j].at(3))) {
-                bool foundRepetition = true;
-                for (int k = 0; k < _init_p; k++) {
-                    if ((_points[k].x == edgeList[steinerNum][i][j].at(0)) & (_points[k].y == edgeList[steinerNum][i][j].at(1))) {
-                        foundRepetition = false;
-                        break;
-                    }
-                }
-                if (foundRepetition) {
-                    edgeList[steinerNum][i].erase(edgeList[steinerNum][i].begin() + j);
-                    j--;
-                }
-            }
+    std::vector<std::vector<std::vector<int>>> &net = edgeList[steinerNum];
+    std::unordered_set<long long> pins;
+    for (int k = 0; k < _init_p; k++) pins.insert(pointKey(_points[k].x, _points[k].y));
+    for (int i = 0; i < net.size(); i++) {
+        std::vector<std::vector<int>> &space = net[i];
+        // single points are only kept on a pin
+        space.erase(remove_if(space.begin(), space.end(), [&](const std::vector<int> &seg) {
+            return seg[0] == seg[2] && seg[1] == seg[3] && !pins.count(pointKey(seg[0], seg[1]));
+        }), space.end());
+        // number of segment ends on every endpoint and the segments ending there
+        std::unordered_map<long long, int> degree;
+        std::unordered_map<long long, std::vector<int>> ends;
+        for (int j = 0; j < space.size(); j++) {
+            long long p1 = pointKey(space[j][0], space[j][1]);
+            long long p2 = pointKey(space[j][2], space[j][3]);
+            degree[p1]++;
+            degree[p2]++;
+            ends[p1].push_back(j);
+            if (p2 != p1) ends[p2].push_back(j);
         }
-
-    }
-    for (int i = 0; i < edgeList[steinerNum].size(); i++) {
-        bool again = true;
-        while (again) {
-            again = false;
-            bool removeSpace = true;
-            std::vector<std::vector<int>> pointsFound;
-            for (int j = 0; j < edgeList[steinerNum][i].size(); j++) {
-                bool foundP1 = false;
-                bool foundP2 = false;
-                for (int k = 0; k < pointsFound.size(); k++) {
-                    if ((edgeList[steinerNum][i][j].at(0) == pointsFound[k].at(0)) & (edgeList[steinerNum][i][j].at(1) == pointsFound[k].at(1))) {
-                        pointsFound[k].at(2)++;
-                        foundP1 = true;
-                    }
-                    if ((edgeList[steinerNum][i][j].at(2) == pointsFound[k].at(0)) & (edgeList[steinerNum][i][j].at(3) == pointsFound[k].at(1))) {
-                        pointsFound[k].at(2)++;
-                        foundP2 = true;
-                    }
-                }
-                if (!foundP1) {
-                    pointsFound.push_back({edgeList[steinerNum][i][j].at(0), edgeList[steinerNum][i][j].at(1), 0});
-                }
-                if (!foundP2) {
-                    pointsFound.push_back({edgeList[steinerNum][i][j].at(2), edgeList[steinerNum][i][j].at(3), 0});
-                }
-            }
-            for (int j = 0; j < _init_p; ++j) {
-                for (int k = 0; k < pointsFound.size(); k++) {
-                    if ((_points[j].x == pointsFound[k].at(0)) & (_points[j].y == pointsFound[k].at(1))) {
-                        pointsFound[k].at(2)++;
-                        removeSpace = false;
-                    }
-                }
-            }
-            if (removeSpace) {
-                edgeList[steinerNum].erase(edgeList[steinerNum].begin() + i);
-                i--;
-            } else {
-                //std::cout << "pointSize: " << pointsFound.size() << std::endl;
-                for (int j = 0; j < pointsFound.size(); j++) {
-                    if (pointsFound[j].at(2) == 0) {
-                        for (int k = 0; k < edgeList[steinerNum][i].size(); k++) {
-                            if ((edgeList[steinerNum][i][k].at(0) == pointsFound[j].at(0)) & (edgeList[steinerNum][i][k].at(1) == pointsFound[j].at(1))) {
-                                edgeList[steinerNum][i].erase(edgeList[steinerNum][i].begin() + k);
-                                k--;
-                                again = true;
-                                break;
-                                // std::cout << "left edge1 is erased" << std::endl;
-                            } else if ((edgeList[steinerNum][i][k].at(2) == pointsFound[j].at(0)) & (edgeList[steinerNum][i][k].at(3) == pointsFound[j].at(1))) {
-                                edgeList[steinerNum][i].erase(edgeList[steinerNum][i].begin() + k);
-                                k--;
-                                again = true;
-                                break;
-                                // std::cout << "right edge1 is erased" << std::endl;
-                            }
-                            // std::cout << "loop did not break: " << k << std::endl;
-                        }
-                    }
-                }
+        // peel dangling segments off from every endpoint used once that is not a pin
+        std::vector<long long> leaves;
+        for (auto &d: degree) {
+            if (d.second == 1 && !pins.count(d.first)) leaves.push_back(d.first);
+        }
+        std::vector<bool> alive(space.size(), true);
+        while (!leaves.empty()) {
+            long long leaf = leaves.back();
+            leaves.pop_back();
+            if (degree[leaf] != 1) continue;
+            for (int j: ends[leaf]) {
+                if (!alive[j]) continue;
+                alive[j] = false;
+                long long p1 = pointKey(space[j][0], space[j][1]);
+                long long p2 = pointKey(space[j][2], space[j][3]);
+                long long other = p1 == leaf ? p2 : p1;
+                degree[leaf]--;
+                if (--degree[other] == 1 && !pins.count(other)) leaves.push_back(other);
+                break;
             }
-            // std::cout << "pointSize: " << pointsFound.size() << std::endl;
+        }
+        // a space left without any pin on it is dropped entirely
+        bool removeSpace = true;
+        int kept = 0;
+        for (int j = 0; j < space.size(); j++) {
+            if (!alive[j]) continue;
+            if (pins.count(pointKey(space[j][0], space[j][1])) || pins.count(pointKey(space[j][2], space[j][3]))) removeSpace = false;
+            space[kept++] = space[j];
+        }
+        space.resize(kept);
+        if (removeSpace) {
+            net.erase(net.begin() + i);
+            i--;
         }
     }
 }
@@ -1299,58 +1466,263 @@ void Steiner::cleanNetlist(std::vector<std::vector<std::vector<std::vector<int>>
 // errors.erase(errors.begin());
 // }
 // }
-void maze_to_file(int m, int n, map<pair<int, int>,int> visit_map, int grid_copy[][n], int** grid){
+// grid dumps: every cell as text only up to this many cells, the preview at most this many characters a side
+static const long long TEXT_DUMP_CELLS = 1LL << 20;
+static const int PREVIEW_SIDE = 256;
+// maze dump value of a cell the router reached that is still empty, '*' in the text
+static const uint8_t MAZE_REACHED = 9;
+
+// run-length dump: "GRLE", then width, height and bytes per cell as uint32, then runs of
+// (uint32 count, cell) over the rows from the top one down, in the order the text dumps print them
+template<typename T, typename Cell>
+static void write_rle(const string &fileName, int width, int height, Cell cell) {
+    ofstream outputFile(fileName, ios::binary | ios::trunc);
+    vector<char> buffer;
+    auto put = [&](const void *data, size_t size) {
+        buffer.insert(buffer.end(), (const char *) data, (const char *) data + size);
+        if (buffer.size() >= (1 << 20)) {
+            outputFile.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    };
+    uint32_t header[3] = {(uint32_t) width, (uint32_t) height, sizeof(T)};
+    put("GRLE", 4);
+    put(header, sizeof(header));
+    uint32_t count = 0;
+    T value = T();
+    for (int i = height - 1; i >= 0; i--) {
+        for (int j = 0; j < width; j++) {
+            T next = cell(j, i);
+            if (count > 0 && next == value && count < UINT32_MAX) {
+                ++count;
+                continue;
+            }
+            if (count > 0) {
+                put(&count, sizeof(count));
+                put(&value, sizeof(value));
+            }
+            value = next;
+            count = 1;
+        }
+    }
+    if (count > 0) {
+        put(&count, sizeof(count));
+        put(&value, sizeof(value));
+    }
+    outputFile.write(buffer.data(), buffer.size());
+}
+
+// text picture of at most PREVIEW_SIDE characters a side, every character stands for
+// a square block of cells and shows the largest value in it
+template<typename Cell, typename Print>
+static void write_preview(const string &fileName, int width, int height, Cell cell, Print print) {
+    int block = max((max(width, height) + PREVIEW_SIDE - 1) / PREVIEW_SIDE, 1);
+    int columns = (width + block - 1) / block;
+    ofstream outputFile(fileName, ios::trunc);
+    outputFile << "# " << width << "x" << height << ", " << block << "x" << block << " cells a character" << '\n';
+    vector<int> line(columns);
+    for (int top = height - 1; top >= 0; top -= block) {
+        fill(line.begin(), line.end(), 0);
+        for (int i = top; i > top - block && i >= 0; i--) {
+            for (int j = 0; j < width; j++) {
+                line[j / block] = max(line[j / block], (int) cell(j, i));
+            }
+        }
+        for (int c = 0; c < columns; c++) print(outputFile, line[c]);
+        outputFile << '\n';
+    }
+}
+
+void maze_to_file(const Grid<uint8_t> &scratch, const StateGrid &grid){
+    auto cell = [&](int j, int i) -> uint8_t {
+        if (scratch(j, i) != SCRATCH_UNSEEN) return grid(j, i) == CELL_EMPTY ? MAZE_REACHED : 1;
+        return cell_digit(grid(j, i));
+    };
+    auto print = [](ofstream &outputFile, int value) {
+        if (value == MAZE_REACHED) outputFile << "*" << " ";
+        else outputFile << value << " ";
+    };
+    write_rle<uint8_t>("out_MAZE.rle", grid.width(), grid.height(), cell);
+    if ((long long) grid.width() * grid.height() > TEXT_DUMP_CELLS) {
+        write_preview("out_MAZE_preview.txt", grid.width(), grid.height(), cell, print);
+        return;
+    }
     ofstream outputFile;
     outputFile.open("out_MAZE.txt", ios::trunc);
-    for (int i = m - 1; i >= 0; i--) {
-        for (int j = 0; j < n; j++) {
-            if (visit_map[pair<int, int>(j, i)] == 1) {
-                if (grid[j][i] == 0){
-                    outputFile << "*" << " ";
-                } else {
-                    outputFile << 1 << " ";
-                }
-            } else {
-                outputFile << abs(grid_copy[j][i]) << " ";
-            }
+    for (int i = grid.height() - 1; i >= 0; i--) {
+        for (int j = 0; j < grid.width(); j++) {
+            print(outputFile, cell(j, i));
         }
-        outputFile << endl;
+        outputFile << '\n';
     }
     outputFile.close();
 }
 
 
 
-int **new_array(int n, int m) {//所产生的二维数组第0行第0列不可用
-    int **aa;
-    aa = new int *[n];
-    for (int i = 0; i < n; i++)
-        aa[i] = new int[m];
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j < m; j++)
-            aa[i][j] = 0;
-    return aa;
-}
-
-void print_grid(int **grid, int bound_x, int bound_y) {
+void print_grid(const Grid<uint16_t> &grid) {
+    auto cell = [&](int j, int i) {
+        return grid(j, i);
+    };
+    write_rle<uint16_t>("out.rle", grid.width(), grid.height(), cell);
+    if ((long long) grid.width() * grid.height() > TEXT_DUMP_CELLS) {
+        write_preview("out_preview.txt", grid.width(), grid.height(), cell, [](ofstream &outputFile, int value) {
+            outputFile << value << " ";
+        });
+        return;
+    }
     ofstream outputFile;
     outputFile.open("out.txt", ios::trunc);
-    for (int i = bound_y - 1; i >= 0; i--) {
-        for (int j = 0; j < bound_x; j++) {
-            if (grid[j][i] < 0) {
-                outputFile << grid[j][i] * -1 << " ";
-            } else {
-                outputFile << grid[j][i] << " ";
-            }
+    for (int i = grid.height() - 1; i >= 0; i--) {
+        for (int j = 0; j < grid.width(); j++) {
+            outputFile << grid(j, i) << " ";
         }
-        outputFile << endl;
+        outputFile << '\n';
     }
     outputFile.close();
 }
 
+vector<vector<int>> cells_to_segments(vector<Position> cells) {
+    // maximal horizontal and vertical runs of adjacent cells, lone cells become points
+    vector<vector<int>> segments;
+    set<pair<int, int>> inRun;
+    sort(cells.begin(), cells.end(), [](const Position &p1, const Position &p2) {
+        return p1.col != p2.col ? p1.col < p2.col : p1.row < p2.row;
+    });
+    for (int i = 0; i < cells.size();) {
+        int j = i;
+        while (j + 1 < cells.size() && cells[j + 1].col == cells[i].col && cells[j + 1].row <= cells[j].row + 1) ++j;
+        if (cells[j].row > cells[i].row) {
+            segments.push_back({cells[i].row, cells[i].col, cells[j].row, cells[i].col});
+            for (int k = i; k <= j; ++k) inRun.emplace(cells[k].row, cells[k].col);
+        }
+        i = j + 1;
+    }
+    sort(cells.begin(), cells.end(), [](const Position &p1, const Position &p2) {
+        return p1.row != p2.row ? p1.row < p2.row : p1.col < p2.col;
+    });
+    for (int i = 0; i < cells.size();) {
+        int j = i;
+        while (j + 1 < cells.size() && cells[j + 1].row == cells[i].row && cells[j + 1].col <= cells[j].col + 1) ++j;
+        if (cells[j].col > cells[i].col) {
+            segments.push_back({cells[i].row, cells[i].col, cells[i].row, cells[j].col});
+            for (int k = i; k <= j; ++k) inRun.emplace(cells[k].row, cells[k].col);
+        } else if (!inRun.count(pair<int, int>(cells[i].row, cells[i].col))) {
+            segments.push_back({cells[i].row, cells[i].col, cells[i].row, cells[i].col});
+        }
+        i = j + 1;
+    }
+    return segments;
+}
+
+// sorts cells along x then y, drops duplicates and gives every cell the index of the
+// set of 4-connected cells it is in, returns the number of sets
+static int label_components(vector<Position> &cells, vector<int> &component) {
+    auto by_scan = [](const Position &a, const Position &b) {
+        return a.row != b.row ? a.row < b.row : a.col < b.col;
+    };
+    sort(cells.begin(), cells.end(), by_scan);
+    cells.erase(unique(cells.begin(), cells.end()), cells.end());
+    static const Position offset[4] = {Position(0, 1), Position(1, 0), Position(0, -1), Position(-1, 0)};
+    component.assign(cells.size(), -1);
+    vector<size_t> stack;
+    int components = 0;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (component[i] >= 0) continue;
+        component[i] = components;
+        stack.push_back(i);
+        while (!stack.empty()) {
+            Position p = cells[stack.back()];
+            stack.pop_back();
+            for (auto &d: offset) {
+                Position q(p.row + d.row, p.col + d.col);
+                auto it = lower_bound(cells.begin(), cells.end(), q, by_scan);
+                if (it == cells.end() || !(*it == q) || component[it - cells.begin()] >= 0) continue;
+                component[it - cells.begin()] = components;
+                stack.push_back(it - cells.begin());
+            }
+        }
+        ++components;
+    }
+    return components;
+}
+
+// union-find over the pieces of a tree being repaired, the smaller index is the root
+static int findRoot(std::vector<int> &parent, int x) {
+    while (parent[x] != x) x = parent[x] = parent[parent[x]];
+    return x;
+}
+
+static void joinRoots(std::vector<int> &parent, int x, int y) {
+    x = findRoot(parent, x);
+    y = findRoot(parent, y);
+    if (x != y) parent[max(x, y)] = min(x, y);
+}
+
+// cells an island may be reconnected through around its box before it searches the whole board
+static const int ISLAND_WINDOW_MARGIN = 16;
+
+// cells on a side of the tiles the whole-board searches of a large board are first routed over
+static const int ROUTING_TILE_SIZE = 32;
+
+// passes of the repair loop at most, the first one included
+static const int REPAIR_ROUNDS = 4;
+
+// out.txt with every cell of tree i marked i + 1
+static void print_routes(const vector<vector<Position>> &true_vectors, int width, int height) {
+    Grid<uint16_t> grid_after(width, height);
+    for (int i = 0; i < true_vectors.size(); ++i) {
+        for (int j = 0; j < true_vectors[i].size(); ++j) {
+            grid_after(true_vectors[i][j].row, true_vectors[i][j].col) = i+1;
+        }
+    }
+    print_grid(grid_after);
+}
+
 void map_generate(vector<std::vector<std::vector<std::vector<int>>>> edge, std::vector<Reroute> intersect, vector<vector<Point>> pin, vector<std::vector<Point>> node, int bound_x, int bound_y) {
-    // build 2d array
-    int **grid = new_array(bound_x, bound_y);
+    // huge boards only keep the tracks of pins, nodes, segment ends and crossings
+    HananAxes axes;
+    if ((long long) bound_x * bound_y > MAX_UNIT_GRID_CELLS) {
+        vector<int> xs, ys;
+        for (auto &net: edge) {
+            for (auto &space: net) {
+                for (auto &seg: space) {
+                    xs.push_back(seg[0]);
+                    xs.push_back(seg[2]);
+                    ys.push_back(seg[1]);
+                    ys.push_back(seg[3]);
+                }
+            }
+        }
+        for (auto &r: intersect) {
+            xs.push_back(r.x);
+            ys.push_back(r.y);
+        }
+        for (int k = 0; k < edge.size(); ++k) {
+            for (auto &p: pin[k]) {
+                xs.push_back(p.x);
+                ys.push_back(p.y);
+            }
+            for (auto &p: node[k]) {
+                xs.push_back(p.x);
+                ys.push_back(p.y);
+            }
+        }
+        axes.build_compressed(xs, ys, bound_x, bound_y);
+#ifdef VERBOSE
+        cout << "routing on a " << axes.width() << "x" << axes.height() << " hanan grid" << endl;
+#endif
+    } else {
+        axes.build_unit(bound_x, bound_y);
+    }
+    // build 2d array, one cell per track crossing
+    StateGrid grid(axes.width(), axes.height());
+    // router buffers of every worker, reused for every island; they only grow to the
+    // island windows, those of the first worker also to the board for the searches over it
+    vector<RouterContext> routers(defaultThreadCount());
+    // conflicts left between the repaired trees and the ones still waiting
+    ConflictEngine conflicts;
+    conflicts.build(edge);
 
     vector<vector<Position>> true_vectors;
     for (int k = 0; k < edge.size(); ++k) {
@@ -1363,355 +1735,492 @@ void map_generate(vector<std::vector<std::vector<std::vector<int>>>> edge, std::
                 int x_2 = edge[k][i][j][2];
                 int y_2 = edge[k][i][j][3];
                 if (x_1 == x_2) {
-                    for (int l = y_1; l <= y_2; ++l) {
-                        true_vectors[k].emplace_back(x_1,l);
+                    for (int l = axes.row(y_1); l <= axes.row(y_2); ++l) {
+                        true_vectors[k].emplace_back(axes.col(x_1),l);
                     }
                 }
                 if (y_1 == y_2) {
-                    for (int l = x_1; l <= x_2; ++l) {
-                        true_vectors[k].emplace_back(l,y_1);
+                    for (int l = axes.col(x_1); l <= axes.col(x_2); ++l) {
+                        true_vectors[k].emplace_back(l,axes.row(y_1));
                     }
                 }
             }
         }
 
     }
-    for (int tree_order = 0; tree_order < edge.size(); ++tree_order) {
-        for (int j = 0; j < edge.size(); ++j) {
-            // for all other trees, go through every edge in every space and set the coord to 1
-            if (tree_order!=j) {
-                for (int k = 0; k < true_vectors[j].size(); ++k) {
-                    grid[true_vectors[j][k].row][true_vectors[j][k].col] = 1;
-                }
+    // many trees on a unit board negotiate for cells instead of being repaired one at a time
+    if (axes.unit() && edge.size() >= NEGOTIATED_ROUTING_NETS) {
+        NegotiatedRouter negotiator(grid.width(), grid.height());
+        for (int k = 0; k < edge.size(); ++k) {
+            vector<Position> terminals;
+            for (int i = 0; i < pin[k].size(); ++i) {
+                terminals.emplace_back(pin[k][i].x, pin[k][i].y);
             }
+            vector<Position> tree_cells = true_vectors[k];
+            tree_cells.insert(tree_cells.end(), terminals.begin(), terminals.end());
+            for (int i = 0; i < node[k].size(); ++i) {
+                tree_cells.emplace_back(node[k][i].x, node[k][i].y);
+            }
+            negotiator.addNet(terminals, tree_cells);
+        }
+        negotiator.run();
+        for (int k = 0; k < edge.size(); ++k) {
+            true_vectors[k] = negotiator.netCells(k);
+            conflicts.updateNet(k, cells_to_segments(true_vectors[k]));
         }
+#ifdef VERBOSE
+        cout << "negotiated routing, shared cells left: " << negotiator.sharedCells() << ", conflicts left: " << conflicts.numConflicts() << endl;
+#endif
+        print_routes(true_vectors, grid.width(), grid.height());
+        return;
+    }
+    // number of tree cell entries on every cell, so a cell a repair wrote can be handed back to the trees on it
+    Grid<uint16_t> owners(grid.width(), grid.height());
+    for (auto &cells: true_vectors) {
+        for (auto &cell: cells) {
+            ++owners(cell.row, cell.col);
+            grid(cell.row, cell.col) = CELL_OTHER_NET;
+        }
+    }
+    // cells the current repair wrote, and cells earlier repairs left as a pin, node or island
+    vector<Position> touched, leftovers;
+    auto write = [&](int x, int y, uint8_t state) {
+        grid(x, y) = state;
+        touched.emplace_back(x, y);
+    };
+    // every tree is repaired once in turn; after that, the trees the engine still finds crossing
+    // another are queued again around those crossings, as long as a pass takes some away
+    vector<int> queue(edge.size());
+    iota(queue.begin(), queue.end(), 0);
+    int rounds = 1, round_conflicts = conflicts.numConflicts();
+    vector<vector<Position>> round_routes;
+    for (size_t next = 0; next < queue.size(); ++next) {
+        int tree_order = queue[next];
+        // every tree is wire of another net except the one being repaired; only the cells
+        // the last repair wrote can have lost that
+        for (auto &cell: touched) {
+            if (owners(cell.row, cell.col) > 0) grid(cell.row, cell.col) = CELL_OTHER_NET;
+        }
+        touched.clear();
         // for tree_order tree, go through every edge in every space and set the coord to -2
         for (int k = 0; k < true_vectors[tree_order].size(); ++k) {
-            grid[true_vectors[tree_order][k].row][true_vectors[tree_order][k].col] = -2;
+            write(true_vectors[tree_order][k].row, true_vectors[tree_order][k].col, CELL_NET);
         }
         // mark intersections to be a 2
         for (int i = 0; i < intersect.size(); ++i) {
-            grid[intersect[i].x][intersect[i].y] = 2;
+            write(axes.col(intersect[i].x), axes.row(intersect[i].y), CELL_DELETE);
         }
 
         // for tree_order tree, mark pin to be -4
         for (int i = 0; i < pin[tree_order].size(); ++i) {
-            grid[pin[tree_order][i].x][pin[tree_order][i].y] = -4;
+            write(axes.col(pin[tree_order][i].x), axes.row(pin[tree_order][i].y), CELL_PIN);
         }
         // for tree_order tree, mark node to be -5
         for (int i = 0; i < node[tree_order].size(); ++i) {
-            grid[node[tree_order][i].x][node[tree_order][i].y] = -5;
+            write(axes.col(node[tree_order][i].x), axes.row(node[tree_order][i].y), CELL_NODE);
+        }
+        // the cells the rays from the intersections run along, and the pins and nodes
+        // that end them: all that was just written plus what earlier repairs left
+        vector<Position> ends;
+        for (auto &cell: touched) {
+            if (grid(cell.row, cell.col) == CELL_PIN || grid(cell.row, cell.col) == CELL_NODE) ends.push_back(cell);
         }
+        SpanIndex tree_spans, end_spans;
+        tree_spans.build(grid.width(), grid.height(), touched);
+        for (auto &cell: leftovers) {
+            uint8_t state = grid(cell.row, cell.col);
+            if (state == CELL_EMPTY || state == CELL_OTHER_NET) continue;
+            tree_spans.insert(cell.row, cell.col);
+            if (state == CELL_PIN || state == CELL_NODE) ends.push_back(cell);
+        }
+        end_spans.build(grid.width(), grid.height(), ends);
         // create delete_path vector
         vector<vector<Position>> delete_path;
         // send delete_path to mark_delete for each intersection with pin, node as finish
         for (int i = 0; i < intersect.size(); ++i) {
-            Position start(intersect[i].x, intersect[i].y);
-            mark_delete(grid, start, bound_x, bound_y, delete_path);
+            Position start(axes.col(intersect[i].x), axes.row(intersect[i].y));
+            mark_delete(tree_spans, end_spans, start, delete_path);
         }
         // set paths to 2
         for (int i = 0; i < delete_path.size(); ++i) {
             for (int j = 0; j < delete_path[i].size(); ++j) {
                 int x = delete_path[i][j].row;
                 int y = delete_path[i][j].col;
-                grid[x][y] = 2;
+                write(x, y, CELL_DELETE);
             }
             // set last element in paths to -1
             int last_element = delete_path[i].size() - 1;
-            grid[delete_path[i][last_element].row][delete_path[i][last_element].col] = -1;
+            write(delete_path[i][last_element].row, delete_path[i][last_element].col, CELL_ISLAND);
         }
+        // only these cut ends can join islands, not the ones earlier repairs left
+        vector<Position> cut_cells;
+        for (auto &path: delete_path) cut_cells.push_back(path.back());
+        SpanIndex cut_ends;
+        cut_ends.build(grid.width(), grid.height(), cut_cells);
 
         // for every island pin and node that has value -1, send source_propagate as start
         vector<Point> node_and_pins;
         for (int i = 0; i < node[tree_order].size(); ++i) {
-            int x = node[tree_order][i].x;
-            int y = node[tree_order][i].y;
+            int x = axes.col(node[tree_order][i].x);
+            int y = axes.row(node[tree_order][i].y);
             node_and_pins.emplace_back(x,y);
         }
         for (int i = 0; i < pin[tree_order].size(); ++i) {
-            node_and_pins.push_back(pin[tree_order][i]);
+            node_and_pins.emplace_back(axes.col(pin[tree_order][i].x), axes.row(pin[tree_order][i].y));
         }
 
+        // every island of the tree is cut off before any of them is reconnected; the wire
+        // no island took is one more piece, the tree, and every piece joins another one
+        vector<vector<Position>> islands;
+        map<pair<int, int>, int> island_of;
         for (int i = 0; i < node_and_pins.size(); ++i) {
             int x = node_and_pins[i].x;
             int y = node_and_pins[i].y;
-            if (grid[x][y] == -1) {
+            if (grid(x, y) == CELL_ISLAND && !island_of.count(pair<int, int>(x, y))) {
                 Position start(x, y);
                 vector<Position> island;
-                source_propagate(grid, start, bound_x, bound_y, island);
-
-                // generate sink_vector
+                source_propagate(grid, cut_ends, start, island);
+                touched.insert(touched.end(), island.begin(), island.end());
+                for (auto &cell: island) {
+                    island_of[pair<int, int>(cell.row, cell.col)] = islands.size();
+                }
+                islands.push_back(island);
+            }
+        }
+        // cuts that end at a run end rather than at a pin or node can leave the wire no island
+        // took in parts; the largest part stays the tree and every other one is one more island
+        vector<Position> wire;
+        for (auto &cell: true_vectors[tree_order]) {
+            if (grid(cell.row, cell.col) == CELL_NET) wire.push_back(cell);
+        }
+        vector<int> part;
+        int parts = label_components(wire, part);
+        if (parts > 1) {
+            vector<int> part_size(parts, 0), island_index(parts, -1);
+            for (int c: part) ++part_size[c];
+            int kept = max_element(part_size.begin(), part_size.end()) - part_size.begin();
+            for (size_t i = 0; i < wire.size(); ++i) {
+                int c = part[i];
+                if (c == kept) continue;
+                if (island_index[c] < 0) {
+                    island_index[c] = islands.size();
+                    islands.emplace_back();
+                }
+                grid(wire[i].row, wire[i].col) = CELL_ISLAND;
+                island_of[pair<int, int>(wire[i].row, wire[i].col)] = island_index[c];
+                islands[island_index[c]].push_back(wire[i]);
+            }
+        }
+        int tree = islands.size();
+        vector<int> parent(tree + 1);
+        iota(parent.begin(), parent.end(), 0);
+        auto piece = [&](int x, int y) {
+            if (grid(x, y) == CELL_NET) return tree;
+            auto it = island_of.find(pair<int, int>(x, y));
+            return it == island_of.end() ? -1 : it->second;
+        };
+        // piece a path ended in, the last cell of a path is the one it started from
+        auto reached = [&](const vector<Position> &path) {
+            const Position &sink = path[path.size() - 2];
+            return piece(sink.row, sink.col);
+        };
+        auto connect = [&](int t, const vector<Position> &path) {
+            cout<<"found"<<endl;
+            joinRoots(parent, t, reached(path));
+            // a path may run over pins, nodes and cut ends no piece took, they become wire too
+            for (auto &cell: path) {
+                if (piece(cell.row, cell.col) >= 0) continue;
+                write(cell.row, cell.col, CELL_ISLAND);
+                island_of[pair<int, int>(cell.row, cell.col)] = t;
+                islands[t].push_back(cell);
+            }
+        };
+        // an island first looks for another piece inside its box plus a margin; islands
+        // whose windows overlap go to later groups and the islands of one group are routed at once
+        vector<SearchWindow> windows;
+        vector<vector<int>> groups;
+        vector<int> group_of;
+        for (int t = 0; t < islands.size(); ++t) {
+            SearchWindow window(INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN);
+            for (auto &cell: islands[t]) {
+                window.xMin = min(window.xMin, cell.row - ISLAND_WINDOW_MARGIN);
+                window.yMin = min(window.yMin, cell.col - ISLAND_WINDOW_MARGIN);
+                window.xMax = max(window.xMax, cell.row + ISLAND_WINDOW_MARGIN);
+                window.yMax = max(window.yMax, cell.col + ISLAND_WINDOW_MARGIN);
+            }
+            int g = 0;
+            for (int s = 0; s < t; ++s) {
+                if (!windows[s].apart(window)) g = max(g, group_of[s] + 1);
+            }
+            if (g == groups.size()) groups.emplace_back();
+            groups[g].push_back(t);
+            group_of.push_back(g);
+            windows.push_back(window);
+        }
+        // a byte per island, the workers set their own ones at the same time
+        vector<uint8_t> found(islands.size(), 0);
+        vector<vector<Position>> paths(islands.size());
+        for (auto &members: groups) {
+            // the workers only read the pieces as they were before the group
+            vector<int> root(tree + 1);
+            for (int k = 0; k <= tree; ++k) {
+                root[k] = findRoot(parent, k);
+            }
+            parallelFor(members.size(), routers.size(), [&](int task, unsigned worker) {
+                int t = members[task];
+                const SearchWindow &window = windows[t];
                 vector<Position> sink_vector;
-                for (int i = 0; i < bound_x; ++i) {
-                    for (int j = 0; j < bound_y; ++j) {
-                        if (grid[i][j] == -2) {
+                for (int j = max(window.yMin, 0); j <= min(window.yMax, grid.height() - 1); ++j) {
+                    for (int i = max(window.xMin, 0); i <= min(window.xMax, grid.width() - 1); ++i) {
+                        int k = piece(i, j);
+                        if (k >= 0 && root[k] != root[t]) {
                             sink_vector.emplace_back(i, j);
                         }
                     }
                 }
-                // create min_route and min_wirelength, route_path and wirelength
-                int min_wirelength = INT32_MAX;
-                int wirelength;
-                int max_block_visited;
-                int block_visited;
-                Position *min_route;
-                Position *route_path;
-                Position start_pos;
-                bool path_found = false;
-                // call FindPath, send every Position in island vector as start and every sink_vector as finish, return minimum PathLen and path
-                for (int j = 0; j < island.size(); ++j) {
-                    for (int k = 0; k < sink_vector.size(); ++k) {
-                        if (FindPath(grid, island[j], sink_vector[k], wirelength, route_path, bound_x, bound_y, block_visited)) {
-                            path_found = true;
-                            if (wirelength < min_wirelength) {
-                                min_wirelength = wirelength;
-                                min_route = route_path;
-                                start_pos = island[j];
-                            }
-                            if (block_visited> max_block_visited){
-                                max_block_visited = block_visited;
-                            }
-                            break;
-                        }
-                    }
-                    if (path_found){
-                        break;
-                    }
-                }
-                // after finding the min_route, change all of its value and path to -2
-                if (path_found){
-                    cout<<"found"<<endl;
-                    for (int j = 0; j < min_wirelength + 1; ++j) {
-                        int x = min_route[j].row;
-                        int y = min_route[j].col;
-                        grid[x][y] = -2;
-                    }
-                }
-                for (int j = 0; j < island.size(); ++j) {
-                    int x = island[j].row;
-                    int y = island[j].col;
-                    grid[x][y] = -2;
+                // one wave from the whole island stops at the cheapest cell of another piece to reach,
+                // keeping clear of other nets and of needless turns where the grid is unit
+                routers[worker].setWindow(window);
+                found[t] = !sink_vector.empty() && routers[worker].findPath(grid, axes, islands[t], sink_vector, SEARCH_CONGESTION);
+                if (found[t]) paths[t] = routers[worker].path();
+            });
+            // applied in island order, so the grid does not depend on the thread count;
+            // a path to a piece an island of the same group already joined is dropped
+            for (int t: members) {
+                if (found[t] && findRoot(parent, t) != findRoot(parent, reached(paths[t]))) {
+                    connect(t, paths[t]);
                 }
-                sink_vector.clear();
-                island.clear();
             }
         }
-
-        // replace 2 with 0, update current true_vectors
-        for (int i = 0; i < bound_x; ++i) {
-            for (int j = 0; j < bound_y; ++j) {
-                if (grid[i][j] == 2) {
-                    grid[i][j] = 0;
+        // pieces still apart search the whole board: the one of the first island grows
+        // towards the closest other piece one wave at a time, and once it cannot reach
+        // any the next island still apart from it takes over
+        routers[0].setWindow(SearchWindow());
+        // on a large board those waves stay in a corridor of tiles first; the pieces
+        // only grow over free cells, so the tiles built here hold for the whole tree
+        bool tiled = (long long) grid.width() * grid.height() > TILED_ROUTING_CELLS;
+        TileGraph tiles;
+        if (tiled) tiles.build(grid, ROUTING_TILE_SIZE);
+        vector<bool> walled_in(tree + 1, false);
+        // every cell of a piece, kept in the order of a scan along x then y: the wire still
+        // on the tree and the islands, which only grow by the paths connected below
+        auto by_scan = [](const Position &a, const Position &b) {
+            return a.row != b.row ? a.row < b.row : a.col < b.col;
+        };
+        vector<Position> piece_cells;
+        for (auto &cell: true_vectors[tree_order]) {
+            if (grid(cell.row, cell.col) == CELL_NET) piece_cells.push_back(cell);
+        }
+        for (auto &island: islands) {
+            piece_cells.insert(piece_cells.end(), island.begin(), island.end());
+        }
+        sort(piece_cells.begin(), piece_cells.end(), by_scan);
+        piece_cells.erase(unique(piece_cells.begin(), piece_cells.end()), piece_cells.end());
+        for (int seed = 0; seed < islands.size(); ++seed) {
+            if (walled_in[findRoot(parent, seed)]) continue;
+            while (true) {
+                vector<Position> sources, sink_vector;
+                for (auto &cell: piece_cells) {
+                    int k = piece(cell.row, cell.col);
+                    if (findRoot(parent, k) == findRoot(parent, seed)) sources.push_back(cell);
+                    else sink_vector.push_back(cell);
                 }
+                if (sink_vector.empty()) break;
+                bool routed = tiled ? routers[0].findPath(grid, axes, tiles, sources, sink_vector, SEARCH_CONGESTION)
+                                    : routers[0].findPath(grid, axes, sources, sink_vector, SEARCH_CONGESTION);
+                if (!routed) break;
+                size_t grown = islands[seed].size();
+                connect(seed, routers[0].path());
+                size_t middle = piece_cells.size();
+                piece_cells.insert(piece_cells.end(), islands[seed].begin() + grown, islands[seed].end());
+                sort(piece_cells.begin() + middle, piece_cells.end(), by_scan);
+                inplace_merge(piece_cells.begin(), piece_cells.begin() + middle, piece_cells.end(), by_scan);
             }
+            walled_in[findRoot(parent, seed)] = true;
         }
-        true_vectors[tree_order].clear();
-        for (int i = 0; i < bound_x; ++i) {
-            for (int j = 0; j < bound_y; ++j) {
-                if (grid[i][j] == -2) {
-                    true_vectors[tree_order].emplace_back(i,j);
-                }
+        for (auto &island: islands) {
+            for (auto &cell: island) {
+                grid(cell.row, cell.col) = CELL_NET;
             }
         }
 
-    }
-    int ** grid_after = new_array(bound_x,bound_y);
-    for (int i = 0; i < edge.size(); ++i) {
-        for (int j = 0; j < true_vectors[i].size(); ++j) {
-            grid_after[true_vectors[i][j].row][true_vectors[i][j].col] = i+1;
+        // replace 2 with 0, update current true_vectors; only the cells this repair
+        // wrote can have changed, taken in the order of a scan along y then x
+        sort(touched.begin(), touched.end(), [](const Position &a, const Position &b) {
+            return a.col != b.col ? a.col < b.col : a.row < b.row;
+        });
+        touched.erase(unique(touched.begin(), touched.end()), touched.end());
+        for (auto &cell: true_vectors[tree_order]) {
+            --owners(cell.row, cell.col);
         }
-    }
-    print_grid(grid_after, bound_x, bound_y);
-}
-
-void mark_delete(int **grid, Position start, int bound_x, int bound_y, vector<vector<Position>> &delete_path) {
-    Position offset[4];
-    offset[0].row = 0;
-    offset[0].col = 1;//右
-    offset[1].row = 1;
-    offset[1].col = 0;//下
-    offset[2].row = 0;
-    offset[2].col = -1;//左
-    offset[3].row = -1;
-    offset[3].col = 0;//上
-    int NumOfNbrs = 4;//相邻方格数
-    Position here, nbr;
-    for (int i = 0; i < NumOfNbrs; i++) {
-        here.row = start.row;
-        here.col = start.col;
-        vector<Position> individual_path;
-        while (true) {
-            // offset position
-            nbr.row = here.row + offset[i].row;
-            nbr.col = here.col + offset[i].col;
-            // check if on boundary
-            if (nbr.row == -1 || nbr.row == bound_x || nbr.col == -1 || nbr.col == bound_y) {
-                break;
-            }
-            // check if a node or a pin is reached
-            if (grid[nbr.row][nbr.col] == -4 || grid[nbr.row][nbr.col] == -5) {
-                individual_path.emplace_back(nbr.row, nbr.col);
-                break;
-            }
-            // check if the path is not empty or other nets
-            if (grid[nbr.row][nbr.col] != 0 && grid[nbr.row][nbr.col] != 1) {
-                individual_path.emplace_back(nbr.row, nbr.col);
-                here.row = nbr.row;
-                here.col = nbr.col;
-            } else {
-                break;
+        true_vectors[tree_order].clear();
+        for (auto &cell: touched) {
+            uint8_t &state = grid(cell.row, cell.col);
+            if (state == CELL_DELETE) {
+                state = CELL_EMPTY;
+            } else if (state == CELL_NET) {
+                true_vectors[tree_order].push_back(cell);
+                ++owners(cell.row, cell.col);
             }
-
         }
-        if (!individual_path.empty()) {
-            delete_path.push_back(individual_path);
+        // the wire of the pieces that were joined is one set of cells now, only pieces no path reached stay apart
+        int apart = 0;
+        for (int k = 0; k <= tree; ++k) apart += findRoot(parent, k) == k;
+        wire = true_vectors[tree_order];
+        assert(label_components(wire, part) <= apart);
+        // pins and nodes no island took, and cut ends no island started from, stay behind
+        leftovers.insert(leftovers.end(), touched.begin(), touched.end());
+        sort(leftovers.begin(), leftovers.end(), by_scan);
+        leftovers.erase(unique(leftovers.begin(), leftovers.end()), leftovers.end());
+        leftovers.erase(remove_if(leftovers.begin(), leftovers.end(), [&](const Position &cell) {
+            uint8_t state = grid(cell.row, cell.col);
+            return state != CELL_PIN && state != CELL_NODE && state != CELL_ISLAND;
+        }), leftovers.end());
+        // only the repaired tree is re-checked against the others
+        vector<Position> tree_cells = true_vectors[tree_order];
+        for (int i = 0; i < pin[tree_order].size(); ++i) {
+            tree_cells.emplace_back(axes.col(pin[tree_order][i].x), axes.row(pin[tree_order][i].y));
+        }
+        for (int i = 0; i < node[tree_order].size(); ++i) {
+            tree_cells.emplace_back(axes.col(node[tree_order][i].x), axes.row(node[tree_order][i].y));
+        }
+        // the engine works on real coordinates
+        vector<vector<int>> tree_segments = cells_to_segments(tree_cells);
+        for (auto &seg: tree_segments) {
+            seg = {axes.x(seg[0]), axes.y(seg[1]), axes.x(seg[2]), axes.y(seg[3])};
+        }
+        conflicts.updateNet(tree_order, tree_segments);
+        if (next + 1 < queue.size()) continue;
+        // a pass after the first that takes no crossing away is undone, and the repair ends there
+        bool undone = rounds > 1 && conflicts.numConflicts() >= round_conflicts;
+        if (undone) true_vectors.swap(round_routes);
+#ifdef VERBOSE
+        cout << "repair round " << rounds << (undone ? " undone" : "") << ", conflicts left: "
+             << (undone ? round_conflicts : conflicts.numConflicts()) << endl;
+#endif
+        if (conflicts.numConflicts() == 0 || conflicts.numConflicts() >= round_conflicts || rounds == REPAIR_ROUNDS) continue;
+        ++rounds;
+        round_conflicts = conflicts.numConflicts();
+        round_routes = true_vectors;
+        intersect = conflicts.getConflicts();
+        vector<int> crossing;
+        for (auto &conflict: intersect) {
+            crossing.push_back(conflict.xNet);
+            crossing.push_back(conflict.yNet);
         }
+        sort(crossing.begin(), crossing.end());
+        crossing.erase(unique(crossing.begin(), crossing.end()), crossing.end());
+        queue.insert(queue.end(), crossing.begin(), crossing.end());
     }
+    print_routes(true_vectors, grid.width(), grid.height());
 }
 
-void source_propagate(int **&grid, Position start, int bound_x, int bound_y, vector<Position> &island) {
-    // looks all four dirs and if the value == -2, record in path, change value to -1
-    map<pair<int,int>,int> visit_map;
-    Position offset[4];
-    offset[0].row = 0;
-    offset[0].col = 1;//右
-    offset[1].row = 1;
-    offset[1].col = 0;//下
-    offset[2].row = 0;
-    offset[2].col = -1;//左
-    offset[3].row = -1;
-    offset[3].col = 0;//上
+void mark_delete(const SpanIndex &tree, const SpanIndex &ends, Position start, vector<vector<Position>> &delete_path) {
+    // from the cell next to start, each way runs along the tree up to the end of its
+    // run or the first pin or node on it, whichever comes first
+    static const Position offset[4] = {Position(0, 1), Position(1, 0), Position(0, -1), Position(-1, 0)};
     int NumOfNbrs = 4;//相邻方格数
-    Position here, nbr;
-    queue <Position, list<Position> > Q;
-    here.row = start.row;
-    here.col = start.col;
-    island.push_back(here);
-    while (true){
-        for (int i = 0; i < NumOfNbrs; i++) {
-            // offset position
-            nbr.row = here.row + offset[i].row;
-            nbr.col = here.col + offset[i].col;
-            // check if on boundary
-            if (nbr.row == -1 || nbr.row == bound_x || nbr.col == -1 || nbr.col == bound_y) {
-                continue;
-            }
-            // check if visited
-            if (visit_map[pair<int,int>(nbr.row,nbr.col)] == 1){
-                continue;
-            } else {
-                visit_map[pair<int,int>(nbr.row,nbr.col)] = 1;
+    for (int i = 0; i < NumOfNbrs; i++) {
+        int dx = offset[i].row, dy = offset[i].col;
+        Position first(start.row + dx, start.col + dy);
+        if (first.row < 0 || first.col < 0 || first.row >= tree.width() || first.col >= tree.height() || !tree.contains(first.row, first.col)) {
+            continue;
+        }
+        int last = tree.runEnd(first.row, first.col, dx, dy);
+        int end = ends.next(first.row, first.col, dx, dy);
+        if (end >= 0 && (dx + dy > 0 ? end < last : end > last)) last = end;
+        vector<Position> individual_path;
+        if (dx) {
+            for (int x = first.row;; x += dx) {
+                individual_path.emplace_back(x, first.col);
+                if (x == last) break;
             }
-            // check if location is -2, -4, -5
-            if (grid[nbr.row][nbr.col] == -2 || grid[nbr.row][nbr.col] == -4 || grid[nbr.row][nbr.col] == -5) {
-                island.emplace_back(nbr.row, nbr.col);
-                Q.push(nbr);
-                grid[nbr.row][nbr.col] = -1;
-            } else {
-                continue;
+        } else {
+            for (int y = first.col;; y += dy) {
+                individual_path.emplace_back(first.row, y);
+                if (y == last) break;
             }
         }
-        if (Q.empty()){
-            break;
-        }
-        here = Q.front();
-        Q.pop();
+        delete_path.push_back(individual_path);
     }
+}
 
-
+// cells source_propagate takes into an island: the tree, or a cut end of this repair touching it;
+// cut ends earlier repairs left behind are wire of no tree
+static bool joins_island(const SpanIndex &cut_ends, int x, int y, uint8_t state) {
+    return state == CELL_NET || state == CELL_PIN || state == CELL_NODE || (state == CELL_ISLAND && cut_ends.contains(x, y));
 }
 
-bool FindPath(int **grid, Position start, Position finish, int &PathLen, Position *&route_path, int n, int m, int &block_visited) {//计算从起始位置start到目标位置finish的最短布线路径
-    // record visited map
-    map<pair<int, int>, int> visit_map;
-    // make new grid every pass
-    int grid_copy[n][m];
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < m; ++j) {
-            grid_copy[i][j] = grid[i][j];
-        }
-    }
-    //找到最短布线路径则返回false
-    int i = 0;
-    if ((start.row == finish.row) && (start.col == finish.col)) {
-        PathLen = 0;
-        return true;
-    }
-    //初始化相对位移
-    Position offset[4];
-    offset[0].row = 0;
-    offset[0].col = 1;//右
-    offset[1].row = 1;
-    offset[1].col = 0;//下
-    offset[2].row = 0;
-    offset[2].col = -1;//左
-    offset[3].row = -1;
-    offset[3].col = 0;//上
-    int NumOfNbrs = 4;//相邻方格数
-    Position here, nbr;
-    here.row = start.row;
-    here.col = start.col;
-    grid_copy[start.row][start.col] = 2;//起始位置的距离标记为2
-
-    grid_copy[finish.row][finish.col] = 0;//终点标记为0
-
-    queue<Position, list<Position> > Q;
-
-    do {
-        for (i = 0; i < NumOfNbrs; i++) {
-            // set adj 4 grids to curr grid cost + 1
-            nbr.row = here.row + offset[i].row; // 按右，下，左，上，移动
-            nbr.col = here.col + offset[i].col;
-            // check if on boundary
-            if (nbr.row == -1 || nbr.row == n || nbr.col == -1 || nbr.col == m) {
-                continue;
-            }
-            // check if visited
-            if (visit_map[pair<int, int>(nbr.row, nbr.col)] == 1) {
-                continue;
-            } else {
-                visit_map[pair<int, int>(nbr.row, nbr.col)] = 1;
-            }
-            // if routable
-            if (grid_copy[nbr.row][nbr.col] == 0 || grid_copy[nbr.row][nbr.col] == -1 || grid_copy[nbr.row][nbr.col] == -2 || grid_copy[nbr.row][nbr.col] == -4 || grid_copy[nbr.row][nbr.col] == -5) {
-                grid_copy[nbr.row][nbr.col] = grid_copy[here.row][here.col] + 1; // curr + 1,
-                // check if any of the 4 is the sink
-                if ((nbr.row == finish.row) && (nbr.col == finish.col))
-                    break;
-                Q.push(nbr);
+void source_propagate(StateGrid &grid, const SpanIndex &cut_ends, Position start, vector<Position> &island) {
+    // scanline fill: a seed grows into the whole run of tree cells along its row, every
+    // run is marked at once and seeds one cell of each run touching it in the rows above and below
+    static thread_local EpochGrid<uint8_t> seen;
+    static thread_local vector<Position> seeds;
+    if (seen.width() != grid.width() || seen.height() != grid.height()) {
+        seen = EpochGrid<uint8_t>(grid.width(), grid.height());
+    } else {
+        seen.reset();
+    }
+    // the start is taken whatever it holds and keeps it
+    uint8_t start_state = grid(start.row, start.col);
+    seeds.assign(1, start);
+    while (!seeds.empty()) {
+        Position seed = seeds.back();
+        seeds.pop_back();
+        if (seen.touched(seed.row, seed.col)) continue;
+        uint8_t *cells = grid.row(seed.col);
+        int y = seed.col, lo = seed.row, hi = seed.row;
+        while (lo > 0 && !seen.touched(lo - 1, y) && joins_island(cut_ends, lo - 1, y, cells[lo - 1])) --lo;
+        while (hi < grid.width() - 1 && !seen.touched(hi + 1, y) && joins_island(cut_ends, hi + 1, y, cells[hi + 1])) ++hi;
+        for (int x = lo; x <= hi; ++x) {
+            seen.set(x, y, 1);
+            island.emplace_back(x, y);
+            cells[x] = CELL_ISLAND;
+        }
+        for (int j = y - 1; j <= y + 1; j += 2) {
+            if (j < 0 || j >= grid.height()) continue;
+            const uint8_t *next = grid.row(j);
+            for (int x = lo; x <= hi; ++x) {
+                if (seen.touched(x, j) || !joins_island(cut_ends, x, j, next[x])) continue;
+                seeds.emplace_back(x, j);
+                while (x < hi && !seen.touched(x + 1, j) && joins_island(cut_ends, x + 1, j, next[x + 1])) ++x;
             }
         }
+    }
+    grid(start.row, start.col) = start_state;
+}
 
-        // 是否到达目标位置finish?
-        if ((nbr.row == finish.row) && (nbr.col == finish.col))
-            break;//完成布线
-        //活结点队列是否非空
-        if (Q.empty()) {
-            PathLen = INT32_MAX;
-            return false;//无解
-        }
-        here = Q.front();//取下一扩展结点
-        Q.pop();//删除第一个元素
-    } while (true);
+// the caller owns route_path and releases it with delete[]
+static void copyPath(const RouterContext &router, int &PathLen, Position *&route_path) {
+    PathLen = router.pathLength();
+    route_path = new Position[PathLen + 1];
+    copy(router.path().begin(), router.path().end(), route_path);
+}
 
+bool FindPath(const StateGrid &grid, Position start, Position finish, int &PathLen, Position *&route_path, int &block_visited, SearchMode mode) {//计算从起始位置start到目标位置finish的最短布线路径
+    static thread_local RouterContext router;
+    bool found = router.findPath(grid, start, finish, mode);
+    block_visited = router.blockVisited();
+    if (found) copyPath(router, PathLen, route_path);
+    else PathLen = INT32_MAX;
+    return found;
+}
 
-    //构造最短布线路径
-    PathLen = grid_copy[finish.row][finish.col] - 2; // 相对于start点的距离 total length - 2 (start cost)
-    route_path = new Position[PathLen + 1];
+bool FindPath(const StateGrid &grid, TileGraph &tiles, Position start, Position finish, int &PathLen, Position *&route_path, int &block_visited) {
+    static thread_local RouterContext router;
+    bool found = router.findPath(grid, tiles, vector<Position>(1, start), vector<Position>(1, finish));
+    block_visited = router.blockVisited();
+    if (found) copyPath(router, PathLen, route_path);
+    else PathLen = INT32_MAX;
+    return found;
+}
 
-    //从目标位置finish开始向起始位置回朔
-    here = finish;
-    for (int j = PathLen - 1; j >= 0; j--) {
-        route_path[j] = here;
-        //找前驱位置
-        for (int i = 0; i < NumOfNbrs; i++) {
-            nbr.row = here.row + offset[i].row;//按右，下，左，上，移动
-            nbr.col = here.col + offset[i].col;
-            if (grid_copy[nbr.row][nbr.col] == j + 2)
-                break;//距离依次减小：7-6-5-4-3-2
-        }
-        here = nbr;//向前移动
-    }
-    block_visited = visit_map.size();
-    return true;
-}
\ No newline at end of file
+bool FindPath(const StateGrid &grid, const HananAxes &axes, Position start, Position finish, int &PathLen, Position *&route_path, long long &wirelength, int &block_visited, SearchMode mode) {
+    static thread_local RouterContext router;
+    bool found = router.findPath(grid, axes, start, finish, mode);
+    block_visited = router.blockVisited();
+    wirelength = router.wirelength();
+    if (found) copyPath(router, PathLen, route_path);
+    else PathLen = INT32_MAX;
+    return found;
+}
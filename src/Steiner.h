@@ -1,11 +1,17 @@
 #ifndef _STEINER_H
 #define _STEINER_H
 
+#include <array>
 #include <vector>
 #include <string>
 #include <tuple>
 #include "datastructure.h"
+#include <map>
 #include "findPath.h"
+#include "grid.h"
+#include "hanan.h"
+#include "router.h"
+#include "spanIndex.h"
 
 class Steiner {
 public:
@@ -24,7 +30,17 @@ public:
 
     void plot(const std::string &plotName);
 
-    int initializeFile(std::ofstream &of);
+    // plot of a view about pixels wide with pins counted per pixel and the routes drawn at
+    // pixel resolution, lines shorter than a pixel left out; the whole board by default
+    void plotLOD(const std::string &plotName, int pixels);
+
+    void plotLOD(const std::string &plotName, int pixels, const Boundary &view);
+
+    // gnuplot settings of a plot file several nets are drawn into, the first idx to use
+    int initializeFile(std::ofstream &file);
+
+    // the plot command of a file from initializeFile, once every net is in
+    void finishFile(std::ofstream &file);
 
     int plotMultiple(std::ofstream &file, int idx, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList,
                      std::vector<std::vector<Point>> &nodeList, std::string color);
@@ -39,6 +55,9 @@ public:
     std::vector<bool> getEdges_del(); //neeeds a getter
     void outfile(const std::string &outfileName);
 
+    // the lines of outfile packed in binary, routes_binary_to_text turns them back into the text
+    void outfileBinary(const std::string &outfileName);
+
     // helper getters
     std::vector<Point> get_points() {
         return _points;
@@ -48,13 +67,14 @@ public:
         return _name;
     }
 
-    int* get_bounds() {
+    // bottom, left, top, right
+    std::array<int, 4> get_bounds() {
 //        std::vector<int> bounds;
 //        bounds.push_back(_boundaryBottom);
 //        bounds.push_back(_boundaryLeft);
 //        bounds.push_back(_boundaryTop);
 //        bounds.push_back(_boundaryRight);
-        int bounds[4];
+        std::array<int, 4> bounds;
         bounds[0] = _boundaryBottom;
         bounds[1] = _boundaryLeft;
         bounds[2] = _boundaryTop;
@@ -91,6 +111,14 @@ private: // helper functions
 
     void buildRST();
 
+    // plot ---------------------
+    std::string plotHeader() const;
+
+    // outfile ---------------------
+    // emit(vertical, fixed, from, to) for every line of the routes in output order
+    template<typename Emit>
+    void forEachLine(Emit emit);
+
     // LCA -----------------------
     int tarfind(int x);
 
@@ -129,20 +157,40 @@ private: // members
     std::vector<int> _init_MST;
 };
 
+// writes the .out text of a file from Steiner::outfileBinary, false when it is not one
+bool routes_binary_to_text(const std::string &binaryName, const std::string &textName);
+
 void checkNets(std::ofstream &file, std::vector<Reroute> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList);
 
+// same result as checkNets, with the net pair search spread over numThreads (0 = all cores)
+void checkNetsParallel(std::ofstream &file, std::vector<Reroute> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList, unsigned numThreads = 0);
+
 // void fixError(std::vector<std::vector<Reroute>> &errors, std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList, int buffer);
-void maze_to_file(int m, int n, map<pair<int, int>,int> visit_map, int grid_copy[][n], int** grid);
+// out_MAZE.rle with every cell run-length coded, and out_MAZE.txt on small grids or a
+// downsampled out_MAZE_preview.txt on large ones
+void maze_to_file(const Grid<uint8_t> &scratch, const StateGrid &grid);
 
-int **new_array(int n, int m);
+// the same for the routes as out.rle, out.txt or out_preview.txt
+void print_grid(const Grid<uint16_t> &grid);
 
-void print_grid(int **grid, int bound_x, int bound_y);
+// ways from start along the cells of tree, each up to the end of its run or the first cell of ends on it
+void mark_delete(const SpanIndex &tree, const SpanIndex &ends, Position start, vector<vector<Position>> &delete_path);
 
-void mark_delete(int **grid, Position start, int bound_x, int bound_y, vector<vector<Position>> &delete_path);
+// the tree cells connected to start become an island, of the cut ends only those in cut_ends
+void source_propagate(StateGrid &grid, const SpanIndex &cut_ends, Position start, vector<Position> &island);
 
-void source_propagate(int **&grid, Position start, int bound_x, int bound_y, vector<Position> &island);
+// horizontal and vertical segments {x1, y1, x2, y2} covering a set of grid cells
+vector<vector<int>> cells_to_segments(vector<Position> cells);
 
 void map_generate(vector<std::vector<std::vector<std::vector<int>>>> edge, std::vector<Reroute> intersect, vector<vector<Point>> pin_nodes, vector<std::vector<Point>> nodeList, int bound_x, int bound_y);
 
-bool FindPath(int **grid, Position start, Position finish, int &PathLen, Position* &route_path, int n, int m, int &max_block_visited);
+// block_visited counts the cells the chosen search looked at; by default the
+// search stays near the two ends and only grows when the path could be shorter further out
+bool FindPath(const StateGrid &grid, Position start, Position finish, int &PathLen, Position* &route_path, int &max_block_visited, SearchMode mode = SEARCH_WINDOWED);
+
+// shortest path on the tracks of axes, PathLen counts steps and wirelength the real length
+bool FindPath(const StateGrid &grid, const HananAxes &axes, Position start, Position finish, int &PathLen, Position* &route_path, long long &wirelength, int &block_visited, SearchMode mode = SEARCH_WINDOWED);
+
+// global route over the tiles built from grid first, then the BFS inside the tiles it took
+bool FindPath(const StateGrid &grid, TileGraph &tiles, Position start, Position finish, int &PathLen, Position* &route_path, int &block_visited);
 #endif
\ No newline at end of file
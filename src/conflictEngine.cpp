@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <tuple>
+#include "conflictEngine.h"
+
+using namespace std;
+
+void ConflictEngine::build(const vector<vector<vector<vector<int>>>> &edgeList) {
+    _segments.clear();
+    _freeIds.clear();
+    _rows.clear();
+    _cols.clear();
+    _numConflicts = 0;
+    _netSegments.assign(edgeList.size(), vector<int>());
+    for (size_t k = 0; k < edgeList.size(); ++k) {
+        for (auto &space: edgeList[k]) {
+            for (auto &seg: space) _netSegments[k].push_back(addSegment(k, seg));
+        }
+    }
+    // findPartners skips pairs that were already linked from the other side
+    for (size_t id = 0; id < _segments.size(); ++id) findPartners(id);
+}
+
+void ConflictEngine::updateNet(int k, const vector<vector<int>> &segments) {
+    if ((size_t) k >= _netSegments.size()) _netSegments.resize(k + 1);
+    for (int id: _netSegments[k]) removeSegment(id);
+    _netSegments[k].clear();
+    for (auto &seg: segments) _netSegments[k].push_back(addSegment(k, seg));
+    for (int id: _netSegments[k]) findPartners(id);
+}
+
+int ConflictEngine::addSegment(int net, const vector<int> &seg) {
+    int id;
+    if (_freeIds.empty()) {
+        id = _segments.size();
+        _segments.emplace_back();
+    } else {
+        id = _freeIds.back();
+        _freeIds.pop_back();
+    }
+    Segment &s = _segments[id];
+    s.net = net;
+    s.x1 = min(seg[0], seg[2]);
+    s.y1 = min(seg[1], seg[3]);
+    s.x2 = max(seg[0], seg[2]);
+    s.y2 = max(seg[1], seg[3]);
+    s.slot = -1;
+    s.partners.clear();
+    // a single point never crosses anything, it is kept only so the net owns it
+    if (isHorizontal(s)) {
+        vector<int> &bucket = _rows[s.y1];
+        s.slot = bucket.size();
+        bucket.push_back(id);
+    } else if (isVertical(s)) {
+        vector<int> &bucket = _cols[s.x1];
+        s.slot = bucket.size();
+        bucket.push_back(id);
+    }
+    return id;
+}
+
+void ConflictEngine::removeSegment(int id) {
+    Segment &s = _segments[id];
+    for (int p: s.partners) {
+        vector<int> &other = _segments[p].partners;
+        other.erase(find(other.begin(), other.end(), id));
+        --_numConflicts;
+    }
+    s.partners.clear();
+    if (s.slot >= 0) {
+        auto it = isHorizontal(s) ? _rows.find(s.y1) : _cols.find(s.x1);
+        vector<int> &bucket = it->second;
+        _segments[bucket.back()].slot = s.slot;
+        bucket[s.slot] = bucket.back();
+        bucket.pop_back();
+        if (bucket.empty()) {
+            if (isHorizontal(s)) _rows.erase(it);
+            else _cols.erase(it);
+        }
+    }
+    _freeIds.push_back(id);
+}
+
+void ConflictEngine::findPartners(int id) {
+    const Segment &s = _segments[id];
+    if (s.slot < 0) return;
+    // a horizontal segment can only cross verticals in its x range and vice versa
+    bool horizontal = isHorizontal(s);
+    const map<int, vector<int>> &index = horizontal ? _cols : _rows;
+    int lo = horizontal ? s.x1 : s.y1;
+    int hi = horizontal ? s.x2 : s.y2;
+    int at = horizontal ? s.y1 : s.x1;
+    for (auto it = index.lower_bound(lo); it != index.end() && it->first <= hi; ++it) {
+        for (int other: it->second) {
+            Segment &o = _segments[other];
+            if (o.net == s.net) continue;
+            int olo = horizontal ? o.y1 : o.x1;
+            int ohi = horizontal ? o.y2 : o.x2;
+            if (at < olo || at > ohi) continue;
+            if (find(o.partners.begin(), o.partners.end(), id) != o.partners.end()) continue;
+            o.partners.push_back(id);
+            _segments[id].partners.push_back(other);
+            ++_numConflicts;
+        }
+    }
+}
+
+vector<Reroute> ConflictEngine::getConflicts() const {
+    vector<Reroute> conflicts;
+    for (size_t id = 0; id < _segments.size(); ++id) {
+        const Segment &s = _segments[id];
+        if (!isVertical(s)) continue;
+        for (int p: s.partners) {
+            const Segment &h = _segments[p];
+            conflicts.emplace_back(s.net, h.net, s.x1, h.y1);
+        }
+    }
+    sort(conflicts.begin(), conflicts.end(), [](const Reroute &r1, const Reroute &r2) {
+        return make_tuple(r1.x, r1.y, r1.xNet, r1.yNet) < make_tuple(r2.x, r2.y, r2.xNet, r2.yNet);
+    });
+    return conflicts;
+}
@@ -0,0 +1,62 @@
+#ifndef _CONFLICTENGINE_H
+#define _CONFLICTENGINE_H
+
+#include <map>
+#include <vector>
+#include "datastructure.h"
+
+// Keeps the crossings between nets up to date while nets are rerouted.
+// Segments are {x1, y1, x2, y2} like in edgeList, and a conflict is what
+// checkNets reports: a vertical and a horizontal segment of different nets
+// sharing a point. Replacing one net only tests its new segments against
+// the row/column index of the others instead of redoing every pair.
+class ConflictEngine {
+public:
+    ConflictEngine() : _numConflicts(0) {}
+
+    ~ConflictEngine() {}
+
+    void build(const std::vector<std::vector<std::vector<std::vector<int>>>> &edgeList);
+
+    // retracts the old conflicts of net k and adds the ones of its new segments
+    void updateNet(int k, const std::vector<std::vector<int>> &segments);
+
+    int numConflicts() const {
+        return _numConflicts;
+    }
+
+    // xNet is the net of the vertical segment, yNet the net of the horizontal one,
+    // sorted by crossing point
+    std::vector<Reroute> getConflicts() const;
+
+private:
+    struct Segment {
+        int net;
+        int x1, y1, x2, y2;
+        int slot; // position inside its row/column bucket
+        std::vector<int> partners; // segments this one crosses
+    };
+
+    int addSegment(int net, const std::vector<int> &seg);
+
+    void removeSegment(int id);
+
+    void findPartners(int id);
+
+    bool isVertical(const Segment &s) const {
+        return s.x1 == s.x2 && s.y1 != s.y2;
+    }
+
+    bool isHorizontal(const Segment &s) const {
+        return s.y1 == s.y2 && s.x1 != s.x2;
+    }
+
+    std::vector<Segment> _segments;
+    std::vector<int> _freeIds;
+    std::vector<std::vector<int>> _netSegments;
+    std::map<int, std::vector<int>> _rows; // y -> horizontal segments
+    std::map<int, std::vector<int>> _cols; // x -> vertical segments
+    int _numConflicts;
+};
+
+#endif
@@ -119,7 +119,7 @@ int main() {
     std::vector<std::vector<std::vector<std::vector<int>>>> edgeList_cp = edgeList;
 
     //assumes input to be a vector of ints with an index compared with a vector of a vector of ints
-    checkNets(outputFile, errors, edgeList);
+    checkNetsParallel(outputFile, errors, edgeList);
 
 
     int bound_x = allSteiners[0].get_bounds()[2] - allSteiners[0].get_bounds()[0];
@@ -145,19 +145,16 @@ int main() {
     for (int i = 0; i < allSteiners.size(); i++) {
         // std::cout << "loop revised " << i << std::endl;
 
-        index2 = allSteiners[i].plotFixed(revisedAgainFile, index3, edgeList, colors, i);
+        index3 = allSteiners[i].plotFixed(revisedAgainFile, index3, edgeList, colors, i);
     }
 
-    outputFile << "plot 1000000000" << std::endl;
-    outputFile << "pause -1 'Press any key'" << std::endl;
+    allSteiners[0].finishFile(outputFile);
     outputFile.close();
 
-    revisedFile << "plot 1000000000" << std::endl;
-    revisedFile << "pause -1 'Press any key'" << std::endl;
+    allSteiners[0].finishFile(revisedFile);
     revisedFile.close();
 
-    revisedAgainFile << "plot 1000000000" << std::endl;
-    revisedAgainFile << "pause -1 'Press any key'" << std::endl;
+    allSteiners[0].finishFile(revisedAgainFile);
     revisedAgainFile.close();
     // // std::vector<int> tempMST = allSteiners[0].getMST();
     // // std::cout << tempMST.size() << std::endl;
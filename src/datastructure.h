@@ -4,6 +4,11 @@
 #include <vector>
 #include <stdlib.h>
 
+// packs a coordinate into a single key for hashing
+inline long long pointKey(int x, int y) {
+    return ((long long) x << 32) | (unsigned int) y;
+}
+
 class Point {
 public:
     Point(int xx = 0, int yy = 0)
@@ -1,3 +1,6 @@
+#ifndef _FINDPATH_H
+#define _FINDPATH_H
+
 #include <iostream>
 #include <list>
 #include <queue>
@@ -99,4 +102,6 @@ public:
 //    outputFile.close();
 //    delete[]grid;
 //    return 0;
-//}
\ No newline at end of file
+//}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,171 @@
+#ifndef _GRID_H
+#define _GRID_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+// state of one routing cell, one byte each
+enum CellState : uint8_t {
+    CELL_EMPTY,     // free, routable
+    CELL_OTHER_NET, // wire of another tree
+    CELL_DELETE,    // intersection or wire being ripped up
+    CELL_ISLAND,    // part of the current tree cut off from the rest
+    CELL_NET,       // wire of the current tree
+    CELL_PIN,       // pin of the current tree
+    CELL_NODE       // steiner node or corner of the current tree
+};
+
+// cells the maze router may walk through
+inline bool cell_routable(uint8_t state) {
+    return state != CELL_OTHER_NET && state != CELL_DELETE;
+}
+
+// digit written for a cell in the text dumps
+inline int cell_digit(uint8_t state) {
+    static const int digits[] = {0, 1, 2, 1, 2, 4, 5};
+    return digits[state];
+}
+
+// labels of the router scratch plane besides the distance mod 3
+const uint8_t SCRATCH_UNSEEN = 0xFF;
+const uint8_t SCRATCH_BLOCKED = 0xFE;
+
+// Routing grid kept in one contiguous row-major block: cell (x, y) is stored
+// at y * width + x, so walking along x is sequential in memory. The block
+// is owned by the grid and released with it.
+template<typename T>
+class Grid {
+public:
+    Grid() : _width(0), _height(0) {}
+
+    Grid(int width, int height, T value = T())
+            : _width(width), _height(height), _cells((size_t) width * height, value) {}
+
+    ~Grid() {}
+
+    int width() const {
+        return _width;
+    }
+
+    int height() const {
+        return _height;
+    }
+
+    bool inside(int x, int y) const {
+        return x >= 0 && x < _width && y >= 0 && y < _height;
+    }
+
+    T &operator()(int x, int y) {
+        return _cells[(size_t) y * _width + x];
+    }
+
+    const T &operator()(int x, int y) const {
+        return _cells[(size_t) y * _width + x];
+    }
+
+    T *row(int y) {
+        return &_cells[(size_t) y * _width];
+    }
+
+    const T *row(int y) const {
+        return &_cells[(size_t) y * _width];
+    }
+
+    void fill(T value) {
+        std::fill(_cells.begin(), _cells.end(), value);
+    }
+
+    // copies other into this grid, reusing the buffer already allocated here
+    void snapshot(const Grid &other) {
+        _width = other._width;
+        _height = other._height;
+        _cells.assign(other._cells.begin(), other._cells.end());
+    }
+
+private:
+    int _width, _height;
+    std::vector<T> _cells;
+};
+
+// Grid whose reset() is O(1): every cell carries the epoch it was written in,
+// and cells from an older epoch read back as the default value. It may cover
+// only a region of a larger grid and still be indexed in that grid's coordinates.
+template<typename T>
+class EpochGrid {
+public:
+    EpochGrid() : _x0(0), _y0(0), _width(0), _height(0), _epoch(1), _default() {}
+
+    EpochGrid(int width, int height, T value = T())
+            : _x0(0), _y0(0), _width(width), _height(height), _values((size_t) width * height, value),
+              _stamps((size_t) width * height, 0), _epoch(1), _default(value) {}
+
+    ~EpochGrid() {}
+
+    int width() const {
+        return _width;
+    }
+
+    int height() const {
+        return _height;
+    }
+
+    bool inside(int x, int y) const {
+        return x >= _x0 && x < _x0 + _width && y >= _y0 && y < _y0 + _height;
+    }
+
+    T get(int x, int y) const {
+        size_t i = index(x, y);
+        return _stamps[i] == _epoch ? _values[i] : _default;
+    }
+
+    void set(int x, int y, T value) {
+        size_t i = index(x, y);
+        _values[i] = value;
+        _stamps[i] = _epoch;
+    }
+
+    // true when the cell was written since the last reset
+    bool touched(int x, int y) const {
+        return _stamps[index(x, y)] == _epoch;
+    }
+
+    void reset() {
+        if (++_epoch == 0) {
+            // the stamps wrapped around, clear them once for real
+            std::fill(_stamps.begin(), _stamps.end(), 0);
+            _epoch = 1;
+        }
+    }
+
+    // covers the width x height cells from (x0, y0) on instead and resets; only
+    // allocates when they are more cells than it ever covered
+    void fit(int x0, int y0, int width, int height) {
+        size_t cells = (size_t) width * height;
+        if (cells > _stamps.size()) {
+            _values.resize(cells, _default);
+            _stamps.resize(cells, 0);
+        }
+        _x0 = x0;
+        _y0 = y0;
+        _width = width;
+        _height = height;
+        reset();
+    }
+
+private:
+    size_t index(int x, int y) const {
+        return (size_t) (y - _y0) * _width + (x - _x0);
+    }
+
+    int _x0, _y0;
+    int _width, _height;
+    std::vector<T> _values;
+    std::vector<unsigned> _stamps;
+    unsigned _epoch;
+    T _default;
+};
+
+typedef Grid<uint8_t> StateGrid;
+
+#endif
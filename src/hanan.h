@@ -0,0 +1,93 @@
+#ifndef _HANAN_H
+#define _HANAN_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+// boards with more unit cells than this are routed on a compressed grid
+const long long MAX_UNIT_GRID_CELLS = 1LL << 29;
+
+// Tracks of the routing grid along x and y. A unit grid has one track per
+// coordinate; a compressed (Hanan) grid only keeps the coordinates that
+// matter plus the tracks right next to them, and a step between two
+// neighbouring tracks costs the real distance between them.
+class HananAxes {
+public:
+    HananAxes() : _unit(true), _width(0), _height(0) {}
+
+    ~HananAxes() {}
+
+    // one track per coordinate of a width x height board
+    void build_unit(int width, int height) {
+        _unit = true;
+        _width = width;
+        _height = height;
+        _xs.clear();
+        _ys.clear();
+    }
+
+    // tracks on the given coordinates and one on each side of them inside the board
+    void build_compressed(const std::vector<int> &xs, const std::vector<int> &ys, int width, int height) {
+        _unit = false;
+        make_tracks(xs, width, _xs);
+        make_tracks(ys, height, _ys);
+        _width = _xs.size();
+        _height = _ys.size();
+    }
+
+    bool unit() const {
+        return _unit;
+    }
+
+    // number of tracks, the size of the routing grid
+    int width() const {
+        return _width;
+    }
+
+    int height() const {
+        return _height;
+    }
+
+    // track of a coordinate, which must be one of the coordinates given to build
+    int col(int x) const {
+        return _unit ? x : std::lower_bound(_xs.begin(), _xs.end(), x) - _xs.begin();
+    }
+
+    int row(int y) const {
+        return _unit ? y : std::lower_bound(_ys.begin(), _ys.end(), y) - _ys.begin();
+    }
+
+    // coordinate of a track
+    int x(int col) const {
+        return _unit ? col : _xs[col];
+    }
+
+    int y(int row) const {
+        return _unit ? row : _ys[row];
+    }
+
+    // real length of the step between two neighbouring tracks
+    int step(int col1, int row1, int col2, int row2) const {
+        if (_unit) return 1;
+        return col1 != col2 ? std::abs(_xs[col1] - _xs[col2]) : std::abs(_ys[row1] - _ys[row2]);
+    }
+
+private:
+    static void make_tracks(const std::vector<int> &coords, int bound, std::vector<int> &tracks) {
+        tracks.clear();
+        for (int c: coords) {
+            tracks.push_back(c);
+            if (c - 1 >= 0) tracks.push_back(c - 1);
+            if (c + 1 < bound) tracks.push_back(c + 1);
+        }
+        std::sort(tracks.begin(), tracks.end());
+        tracks.erase(std::unique(tracks.begin(), tracks.end()), tracks.end());
+    }
+
+    bool _unit;
+    int _width, _height;
+    std::vector<int> _xs, _ys;
+};
+
+#endif
@@ -2,20 +2,23 @@
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
 #include "util.h"
 #include "Steiner.h"
 #include "rebound.h"
-#include "Num_Nets_Pins.h"
 
 using namespace std;
 
-bool gDoplot, gOutfile;
-string plotName, outfileName;
+bool gDoplot, gOutfile, gOutBinary, gDoplotLOD, gZoom;
+string plotName, outfileName, outBinaryName, plotLODName;
+int plotPixels;
+int zoomLeft, zoomBottom, zoomRight, zoomTop;
 
 bool handleArgument(const int &argc, char **argv) {
     int i = 0;
     if (argc < 2) {
-        fprintf(stderr, "Usage: ./steiner <input> [-out <.out>] [-plot <.plt>]\n");
+        fprintf(stderr, "Usage: ./steiner <input> [-out <.out>] [-outbin <.bin>] [-plot <.plt>]"
+                        " [-plotlod <.plt> <pixels>] [-zoom <x1> <y1> <x2> <y2>]\n");
         return false;
     }
     while (i < argc) {
@@ -25,12 +28,41 @@ bool handleArgument(const int &argc, char **argv) {
         } else if (strcmp(argv[i] + 1, "plot") == 0) {
             gDoplot = true;
             plotName = argv[++i];
+        } else if (strcmp(argv[i] + 1, "plotlod") == 0) {
+            if (i + 2 >= argc) {
+                fprintf(stderr, "-plotlod needs a file name and a number of pixels\n");
+                return false;
+            }
+            gDoplotLOD = true;
+            plotLODName = argv[++i];
+            plotPixels = atoi(argv[++i]);
+        } else if (strcmp(argv[i] + 1, "zoom") == 0) {
+            if (i + 4 >= argc) {
+                fprintf(stderr, "-zoom needs x1 y1 x2 y2\n");
+                return false;
+            }
+            gZoom = true;
+            zoomLeft = atoi(argv[++i]);
+            zoomBottom = atoi(argv[++i]);
+            zoomRight = atoi(argv[++i]);
+            zoomTop = atoi(argv[++i]);
         } else if (strcmp(argv[i] + 1, "out") == 0) {
             gOutfile = true;
             outfileName = argv[++i];
+        } else if (strcmp(argv[i] + 1, "outbin") == 0) {
+            gOutBinary = true;
+            outBinaryName = argv[++i];
         }
         ++i;
     }
+    if (gDoplotLOD && plotPixels < 1) {
+        fprintf(stderr, "-plotlod needs a positive number of pixels\n");
+        return false;
+    }
+    if (gZoom && (zoomLeft >= zoomRight || zoomBottom >= zoomTop)) {
+        fprintf(stderr, "-zoom needs x1 < x2 and y1 < y2\n");
+        return false;
+    }
     return true;
 }
 
@@ -56,6 +88,14 @@ int main(int argc, char **argv) {
 #ifdef VERBOSE
         timer.showUsage("plot", TimeUsage::PARTIAL);
         timer.start(TimeUsage::PARTIAL);
+#endif
+    }
+    if (gDoplotLOD) {
+        if (gZoom) st_1.plotLOD(plotLODName, plotPixels, Boundary(zoomLeft, zoomRight, zoomBottom, zoomTop));
+        else st_1.plotLOD(plotLODName, plotPixels);
+#ifdef VERBOSE
+        timer.showUsage("plotLOD", TimeUsage::PARTIAL);
+        timer.start(TimeUsage::PARTIAL);
 #endif
     }
     if (gOutfile) {
@@ -63,6 +103,13 @@ int main(int argc, char **argv) {
 #ifdef VERBOSE
         timer.showUsage("outfile", TimeUsage::PARTIAL);
         timer.start(TimeUsage::PARTIAL);
+#endif
+    }
+    if (gOutBinary) {
+        st_1.outfileBinary(outBinaryName);
+#ifdef VERBOSE
+        timer.showUsage("outfileBinary", TimeUsage::PARTIAL);
+        timer.start(TimeUsage::PARTIAL);
 #endif
     }
     timer.showUsage("Steiner", TimeUsage::FULL);
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include "negotiatedRouter.h"
+#include "parallel.h"
+
+using namespace std;
+
+// cost of one round of history on a cell and bounds of the present cost factor
+static const int HISTORY_COST = 2;
+static const int FIRST_PRESENT_FACTOR = 2;
+static const int MAX_PRESENT_FACTOR = 4096;
+// rounds without fewer shared cells before the negotiation gives up; on a
+// single layer some crossings cannot be negotiated away
+static const int STALL_ROUNDS = 8;
+// cells a net may be rerouted outside the box of its cells and terminals
+static const int BOX_MARGIN = 8;
+
+static const Position offset[4] = {Position(0, 1), Position(1, 0), Position(0, -1), Position(-1, 0)};
+static const int NumOfNbrs = 4;
+
+static bool samePosition(const Position &p1, const Position &p2) {
+    return p1.row == p2.row && p1.col == p2.col;
+}
+
+static bool lessPosition(const Position &p1, const Position &p2) {
+    return p1.row != p2.row ? p1.row < p2.row : p1.col < p2.col;
+}
+
+NegotiatedRouter::NegotiatedRouter(int width, int height)
+        : _free(width, height), _occupancy(width, height), _history(width, height), _cost(width, height) {}
+
+int NegotiatedRouter::addNet(const vector<Position> &terminals, const vector<Position> &cells) {
+    Net net;
+    net.terminals = terminals;
+    sort(net.terminals.begin(), net.terminals.end(), lessPosition);
+    net.terminals.erase(unique(net.terminals.begin(), net.terminals.end(), samePosition), net.terminals.end());
+    net.cells = cells;
+    sort(net.cells.begin(), net.cells.end(), lessPosition);
+    net.cells.erase(unique(net.cells.begin(), net.cells.end(), samePosition), net.cells.end());
+    fitWindow(net);
+    occupy(net.cells, 1);
+    _nets.push_back(net);
+    return _nets.size() - 1;
+}
+
+void NegotiatedRouter::fitWindow(Net &net) {
+    SearchWindow &box = net.window;
+    box = SearchWindow(INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN);
+    auto cover = [&](const Position &p) {
+        box.xMin = min(box.xMin, p.row - BOX_MARGIN);
+        box.xMax = max(box.xMax, p.row + BOX_MARGIN);
+        box.yMin = min(box.yMin, p.col - BOX_MARGIN);
+        box.yMax = max(box.yMax, p.col + BOX_MARGIN);
+    };
+    for_each(net.terminals.begin(), net.terminals.end(), cover);
+    for_each(net.cells.begin(), net.cells.end(), cover);
+}
+
+void NegotiatedRouter::occupy(const vector<Position> &cells, int delta) {
+    for (auto &p: cells) _occupancy(p.row, p.col) += delta;
+}
+
+bool NegotiatedRouter::shared(const Net &net) const {
+    for (auto &p: net.cells) {
+        if (_occupancy(p.row, p.col) > 1) return true;
+    }
+    return false;
+}
+
+// index of p in cells sorted by lessPosition, -1 when it is not there
+static int findCell(const vector<Position> &cells, const Position &p) {
+    auto it = lower_bound(cells.begin(), cells.end(), p, lessPosition);
+    return it != cells.end() && samePosition(*it, p) ? it - cells.begin() : -1;
+}
+
+// component of every cell, cells sorted by lessPosition
+static int labelComponents(const vector<Position> &cells, vector<int> &component) {
+    component.assign(cells.size(), -1);
+    int components = 0;
+    vector<int> stack;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (component[i] >= 0) continue;
+        component[i] = components;
+        stack.push_back(i);
+        while (!stack.empty()) {
+            Position p = cells[stack.back()];
+            stack.pop_back();
+            for (int j = 0; j < NumOfNbrs; ++j) {
+                int k = findCell(cells, Position(p.row + offset[j].row, p.col + offset[j].col));
+                if (k >= 0 && component[k] < 0) {
+                    component[k] = components;
+                    stack.push_back(k);
+                }
+            }
+        }
+        ++components;
+    }
+    return components;
+}
+
+void NegotiatedRouter::ripUp(const Net &net, vector<Position> &cells) const {
+    vector<bool> keep(cells.size(), true), terminal(cells.size(), false);
+    for (auto &p: net.terminals) {
+        int k = findCell(cells, p);
+        if (k >= 0) terminal[k] = true;
+    }
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (!terminal[i] && _occupancy(cells[i].row, cells[i].col) > 0) keep[i] = false;
+    }
+    // peel off the wire left hanging where a shared cell was cut out
+    vector<int> degree(cells.size(), 0), leaves;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (!keep[i]) continue;
+        for (int j = 0; j < NumOfNbrs; ++j) {
+            int k = findCell(cells, Position(cells[i].row + offset[j].row, cells[i].col + offset[j].col));
+            if (k >= 0 && keep[k]) ++degree[i];
+        }
+        if (degree[i] <= 1 && !terminal[i]) leaves.push_back(i);
+    }
+    while (!leaves.empty()) {
+        int i = leaves.back();
+        leaves.pop_back();
+        if (!keep[i]) continue;
+        keep[i] = false;
+        for (int j = 0; j < NumOfNbrs; ++j) {
+            int k = findCell(cells, Position(cells[i].row + offset[j].row, cells[i].col + offset[j].col));
+            if (k >= 0 && keep[k] && --degree[k] <= 1 && !terminal[k]) leaves.push_back(k);
+        }
+    }
+    vector<Position> kept;
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (keep[i]) kept.push_back(cells[i]);
+    }
+    cells.swap(kept);
+}
+
+void NegotiatedRouter::routeNet(const Net &net, RouterContext &router, vector<Position> &cells) const {
+    cells = net.cells;
+    cells.insert(cells.end(), net.terminals.begin(), net.terminals.end());
+    sort(cells.begin(), cells.end(), lessPosition);
+    cells.erase(unique(cells.begin(), cells.end(), samePosition), cells.end());
+    ripUp(net, cells);
+    if (net.terminals.size() < 2) return;
+    router.setCosts(RouteCosts(0, 1, &_cost));
+    // nets routed at the same time keep to windows that do not overlap
+    router.setWindow(net.window);
+    // join the pieces left to the one of the first terminal, cheapest path first;
+    // pieces without a terminal are dropped
+    vector<int> component;
+    while (true) {
+        vector<bool> needed(labelComponents(cells, component), false);
+        for (auto &p: net.terminals) {
+            needed[component[findCell(cells, p)]] = true;
+        }
+        int root = component[findCell(cells, net.terminals[0])];
+        vector<Position> sources, sinks, kept;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (!needed[component[i]]) continue;
+            kept.push_back(cells[i]);
+            if (component[i] == root) sources.push_back(cells[i]);
+            else sinks.push_back(cells[i]);
+        }
+        cells.swap(kept);
+        if (sinks.empty()) break;
+        // nothing is blocked and the window holds every piece, so a path is always found
+        router.findPath(_free, sources, sinks, SEARCH_CONGESTION);
+        const vector<Position> &path = router.path();
+        cells.insert(cells.end(), path.begin(), path.begin() + router.pathLength());
+        sort(cells.begin(), cells.end(), lessPosition);
+        cells.erase(unique(cells.begin(), cells.end(), samePosition), cells.end());
+    }
+}
+
+int NegotiatedRouter::run(int maxRounds, unsigned numThreads) {
+    if (numThreads == 0) numThreads = defaultThreadCount();
+    vector<RouterContext> routers(numThreads);
+    int presentFactor = FIRST_PRESENT_FACTOR;
+    int width = _occupancy.width(), height = _occupancy.height();
+    // sharing moves around before it goes away, so the least shared round is kept
+    int bestShared = sharedCells();
+    vector<vector<Position>> best;
+    for (auto &net: _nets) best.push_back(net.cells);
+    int bestRound = 0;
+    for (int round = 0; round < maxRounds && (round == 0 || bestShared > 0) && round - bestRound <= STALL_ROUNDS; ++round) {
+        // the first round also joins the nets that came in pieces
+        vector<int> ripped;
+        for (size_t k = 0; k < _nets.size(); ++k) {
+            if (round == 0 || shared(_nets[k])) ripped.push_back(k);
+        }
+        for (int y = 0; y < height; ++y) {
+            const uint16_t *occupancy = _occupancy.row(y);
+            uint16_t *history = _history.row(y);
+            for (int x = 0; x < width; ++x) {
+                if (occupancy[x] > 1 && history[x] < UINT16_MAX) ++history[x];
+            }
+        }
+        // first fit into batches whose windows do not overlap, in net order
+        vector<vector<int>> batches;
+        for (int k: ripped) {
+            auto apart = [&](int other) {
+                return _nets[k].window.apart(_nets[other].window);
+            };
+            auto batch = find_if(batches.begin(), batches.end(), [&](const vector<int> &members) {
+                return all_of(members.begin(), members.end(), apart);
+            });
+            if (batch == batches.end()) batches.emplace_back(1, k);
+            else batch->push_back(k);
+        }
+        for (auto &batch: batches) {
+            for (int k: batch) occupy(_nets[k].cells, -1);
+            for (int y = 0; y < height; ++y) {
+                const uint16_t *occupancy = _occupancy.row(y);
+                const uint16_t *history = _history.row(y);
+                uint16_t *cost = _cost.row(y);
+                for (int x = 0; x < width; ++x) {
+                    long long c = (long long) history[x] * HISTORY_COST + (long long) occupancy[x] * presentFactor;
+                    cost[x] = min(c, (long long) UINT16_MAX);
+                }
+            }
+            vector<vector<Position>> routes(batch.size());
+            parallelFor(batch.size(), numThreads, [&](int task, unsigned worker) {
+                routeNet(_nets[batch[task]], routers[worker], routes[task]);
+            });
+            for (size_t i = 0; i < batch.size(); ++i) {
+                _nets[batch[i]].cells.swap(routes[i]);
+                fitWindow(_nets[batch[i]]);
+                occupy(_nets[batch[i]].cells, 1);
+            }
+        }
+        presentFactor = min(presentFactor * 2, MAX_PRESENT_FACTOR);
+        int roundShared = sharedCells();
+        if (roundShared < bestShared) {
+            bestShared = roundShared;
+            bestRound = round;
+            for (size_t k = 0; k < _nets.size(); ++k) best[k] = _nets[k].cells;
+        }
+    }
+    for (size_t k = 0; k < _nets.size(); ++k) {
+        occupy(_nets[k].cells, -1);
+        _nets[k].cells.swap(best[k]);
+        occupy(_nets[k].cells, 1);
+    }
+    return bestShared;
+}
+
+int NegotiatedRouter::sharedCells() const {
+    int sharedCells = 0;
+    for (int y = 0; y < _occupancy.height(); ++y) {
+        const uint16_t *occupancy = _occupancy.row(y);
+        for (int x = 0; x < _occupancy.width(); ++x) sharedCells += occupancy[x] > 1;
+    }
+    return sharedCells;
+}
@@ -0,0 +1,67 @@
+#ifndef _NEGOTIATEDROUTER_H
+#define _NEGOTIATEDROUTER_H
+
+#include <vector>
+#include "findPath.h"
+#include "grid.h"
+#include "router.h"
+
+// designs with at least this many nets are routed by negotiation in map_generate
+const int NEGOTIATED_ROUTING_NETS = 8;
+
+// PathFinder-style rip-up and reroute on a unit grid. Nets may share cells,
+// but every shared cell gets more expensive: its present cost grows with
+// the nets on it and the round, and its history cost grows every round it
+// stays shared. Each round cuts the shared cells out of the nets on them
+// and reconnects what is left, until no cell is shared. Every net is rerouted
+// inside its own window, nets whose windows do not overlap in parallel.
+class NegotiatedRouter {
+public:
+    NegotiatedRouter(int width, int height);
+
+    ~NegotiatedRouter() {}
+
+    // adds a net that has to connect terminals, starting from the given cells
+    // (its current tree, may be empty), returns its index
+    int addNet(const std::vector<Position> &terminals, const std::vector<Position> &cells);
+
+    // negotiates for at most maxRounds rounds and keeps the routes of the round
+    // that shared the fewest cells, returns how many they share
+    int run(int maxRounds = 50, unsigned numThreads = 0);
+
+    const std::vector<Position> &netCells(int k) const {
+        return _nets[k].cells;
+    }
+
+    // cells more than one net is on
+    int sharedCells() const;
+
+private:
+    struct Net {
+        std::vector<Position> terminals;
+        std::vector<Position> cells;
+        SearchWindow window; // box of the cells and terminals plus a margin, the net is rerouted inside it
+    };
+
+    // window of net after its cells changed
+    static void fitWindow(Net &net);
+
+    bool shared(const Net &net) const;
+
+    // drops the cells of net other nets are on and the wire that only led to them,
+    // cells sorted by position
+    void ripUp(const Net &net, std::vector<Position> &cells) const;
+
+    // net after ripUp, its pieces joined again one cheapest path at a time
+    void routeNet(const Net &net, RouterContext &router, std::vector<Position> &cells) const;
+
+    void occupy(const std::vector<Position> &cells, int delta);
+
+    StateGrid _free;             // nothing is blocked, sharing is paid for instead
+    Grid<uint16_t> _occupancy;   // nets on every cell
+    Grid<uint16_t> _history;     // rounds every cell has been shared
+    Grid<uint16_t> _cost;        // extra cost of every cell for the nets being rerouted
+    std::vector<Net> _nets;
+};
+
+#endif
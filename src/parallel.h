@@ -0,0 +1,104 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of workers to use when the caller passes 0
+inline unsigned defaultThreadCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// runs body(task, worker) for every task in [0, numTasks)
+// tasks are handed out one at a time so uneven tasks still balance,
+// worker is in [0, numThreads) and can index per-thread buffers
+template<typename Body>
+void parallelFor(int numTasks, unsigned numThreads, Body body) {
+    if (numThreads == 0) numThreads = defaultThreadCount();
+    if (numThreads > (unsigned) numTasks) numThreads = numTasks;
+    if (numThreads <= 1) {
+        for (int t = 0; t < numTasks; ++t) body(t, 0);
+        return;
+    }
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < numThreads; ++w) {
+        workers.emplace_back([&, w]() {
+            for (int t = next++; t < numTasks; t = next++) body(t, w);
+        });
+    }
+    for (auto &th: workers) th.join();
+}
+
+// Threads kept for a sequence of short parallel steps, where starting new
+// threads for every step would cost more than the step: run(body) calls
+// body(worker) once on every worker, the caller being worker 0, and
+// returns when all of them are done.
+class ThreadTeam {
+public:
+    explicit ThreadTeam(unsigned numThreads) : _generation(0), _pending(0), _stop(false) {
+        if (numThreads == 0) numThreads = defaultThreadCount();
+        for (unsigned w = 1; w < numThreads; ++w) {
+            _workers.emplace_back([this, w]() { work(w); });
+        }
+    }
+
+    ~ThreadTeam() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start.notify_all();
+        for (auto &th: _workers) th.join();
+    }
+
+    unsigned size() const {
+        return _workers.size() + 1;
+    }
+
+    void run(const std::function<void(unsigned)> &body) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _body = &body;
+            _pending = _workers.size();
+            ++_generation;
+        }
+        _start.notify_all();
+        body(0);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [this]() { return _pending == 0; });
+    }
+
+private:
+    void work(unsigned worker) {
+        unsigned long long seen = 0;
+        while (true) {
+            const std::function<void(unsigned)> *body;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start.wait(lock, [&]() { return _stop || _generation != seen; });
+                if (_stop) return;
+                seen = _generation;
+                body = _body;
+            }
+            (*body)(worker);
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0) _done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start, _done;
+    const std::function<void(unsigned)> *_body;
+    unsigned long long _generation;
+    size_t _pending;
+    bool _stop;
+};
+
+#endif
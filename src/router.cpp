@@ -0,0 +1,890 @@
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include "parallel.h"
+#include "router.h"
+
+using namespace std;
+
+// neighbours in the order the router tries them: right, down, left, up
+static const Position offset[4] = {Position(0, 1), Position(1, 0), Position(0, -1), Position(-1, 0)};
+static const int NumOfNbrs = 4;
+
+// marks of the cells a search starts from and may stop at
+static const uint8_t MARK_NONE = 0;
+static const uint8_t MARK_SOURCE = 1;
+static const uint8_t MARK_SINK = 2;
+
+// label bit of the cells reached from the finish in a bidirectional search
+static const uint8_t BACKWARD = 8;
+
+// the line probe gives up and runs the BFS once it has this many lines
+static const size_t MAX_PROBE_LINES = 4096;
+
+// tracks around the box of the two ends the first window of a windowed search keeps
+static const int FIRST_WINDOW_MARGIN = 8;
+
+// tiles around the tile route a tiled search may also use
+static const int CORRIDOR_HALO = 1;
+
+// a level of the parallel wave is spread over the threads once it has this many cells to look at
+static const size_t PARALLEL_LEVEL_CELLS = 4096;
+// frontier cells a thread takes at a time
+static const size_t WAVE_CHUNK = 256;
+// the parallel wave looks from the unvisited cells for the frontier once the frontier times this outgrows them
+static const long long BOTTOM_UP_FACTOR = 14;
+// epochs of the parallel wave marks wrap around here
+static const uint32_t MAX_WAVE_EPOCH = 1u << 30;
+
+SearchWindow RouterContext::searchRegion(const StateGrid &grid, const vector<Position> &sources) const {
+    SearchWindow region(max(_window.xMin, 0), max(_window.yMin, 0),
+                        min(_window.xMax, grid.width() - 1), min(_window.yMax, grid.height() - 1));
+    for (auto &p: sources) {
+        region.xMin = min(region.xMin, p.row);
+        region.yMin = min(region.yMin, p.col);
+        region.xMax = max(region.xMax, p.row);
+        region.yMax = max(region.yMax, p.col);
+    }
+    return region;
+}
+
+void RouterContext::prepare(const SearchWindow &region) {
+    int width = max(region.xMax - region.xMin + 1, 0), height = max(region.yMax - region.yMin + 1, 0);
+    _labels.fit(region.xMin, region.yMin, width, height);
+    _marks.fit(region.xMin, region.yMin, width, height);
+    _queue.clear();
+    _backQueue.clear();
+    _path.clear();
+}
+
+void RouterContext::prepareDistances(const SearchWindow &region) {
+    _dist.fit(region.xMin, region.yMin, max(region.xMax - region.xMin + 1, 0), max(region.yMax - region.yMin + 1, 0));
+}
+
+template<typename Parent>
+void RouterContext::tracePath(Position finish, Parent parent) {
+    _path.clear();
+    Position here = finish;
+    for (; _marks.get(here.row, here.col) != MARK_SOURCE; here = parent(here)) _path.push_back(here);
+    _pathLength = _path.size();
+    reverse(_path.begin(), _path.end());
+    _path.push_back(here);
+}
+
+void RouterContext::traceLayers(Position finish) {
+    // neighbours one step closer carry the previous label
+    tracePath(finish, [this](Position cell) {
+        uint8_t previous = (_labels.get(cell.row, cell.col) + 2) % 3;
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position next(cell.row + offset[i].row, cell.col + offset[i].col);
+            if (_labels.inside(next.row, next.col) && _labels.get(next.row, next.col) == previous) return next;
+        }
+        return cell;
+    });
+    _wirelength = _pathLength;
+}
+
+bool RouterContext::findPath(const StateGrid &grid, Position start, Position finish, SearchMode mode) {
+    if (mode == SEARCH_ASTAR) {
+        _unitAxes.build_unit(grid.width(), grid.height());
+        return searchAStar(grid, _unitAxes, start, finish);
+    }
+    if (mode == SEARCH_BIDIRECTIONAL) return searchBidirectional(grid, start, finish);
+    if (mode == SEARCH_BITWAVE) return searchBitwave(grid, start, finish);
+    if (mode == SEARCH_LINEPROBE) return searchLineProbe(grid, start, finish);
+    if (mode == SEARCH_PARALLEL) return searchParallel(grid, start, finish);
+    if (mode == SEARCH_WINDOWED) {
+        _unitAxes.build_unit(grid.width(), grid.height());
+        return searchWindowed(grid, _unitAxes, start, finish);
+    }
+    _sources.assign(1, start);
+    _sinks.assign(1, finish);
+    return findPath(grid, _sources, _sinks, mode);
+}
+
+bool RouterContext::findPath(const StateGrid &grid, const HananAxes &axes, Position start, Position finish, SearchMode mode) {
+    if (axes.unit()) return findPath(grid, start, finish, mode);
+    if (mode == SEARCH_ASTAR) return searchAStar(grid, axes, start, finish);
+    if (mode == SEARCH_WINDOWED) return searchWindowed(grid, axes, start, finish);
+    _sources.assign(1, start);
+    _sinks.assign(1, finish);
+    return findPath(grid, axes, _sources, _sinks);
+}
+
+bool RouterContext::findPath(const StateGrid &grid, const vector<Position> &sources, const vector<Position> &sinks, SearchMode mode) {
+    if (mode == SEARCH_CONGESTION) return searchCongestion(grid, sources, sinks);
+    prepare(searchRegion(grid, sources));
+    _blockVisited = 0;
+    // sinks outside the window are never entered
+    for (auto &p: sinks) {
+        if (_marks.inside(p.row, p.col)) _marks.set(p.row, p.col, MARK_SINK);
+    }
+    for (auto &p: sources) {
+        if (_marks.get(p.row, p.col) == MARK_SINK) {
+            _path.push_back(p);
+            _pathLength = 0;
+            _wirelength = 0;
+            _blockVisited = 1;
+            return true;
+        }
+    }
+    // every reached cell is labelled with its distance mod 3, all sources are at 0
+    for (auto &p: sources) {
+        if (_labels.touched(p.row, p.col)) continue;
+        _marks.set(p.row, p.col, MARK_SOURCE);
+        _labels.set(p.row, p.col, 0);
+        _queue.push(p);
+        ++_blockVisited;
+    }
+    Position here, nbr;
+    while (!_queue.empty()) {
+        here = _queue.front();
+        _queue.pop();
+        for (int i = 0; i < NumOfNbrs; i++) {
+            nbr.row = here.row + offset[i].row;
+            nbr.col = here.col + offset[i].col;
+            if (!inWindow(grid, nbr) || _labels.touched(nbr.row, nbr.col)) {
+                continue;
+            }
+            ++_blockVisited;
+            bool sink = _marks.get(nbr.row, nbr.col) == MARK_SINK;
+            if (cell_routable(grid(nbr.row, nbr.col)) || sink) {
+                _labels.set(nbr.row, nbr.col, (_labels.get(here.row, here.col) + 1) % 3);
+                if (sink) {
+                    traceLayers(nbr);
+                    return true;
+                }
+                _queue.push(nbr);
+            } else {
+                _labels.set(nbr.row, nbr.col, SCRATCH_BLOCKED);
+            }
+        }
+    }
+    _pathLength = INT32_MAX;
+    _wirelength = INT64_MAX;
+    return false;
+}
+
+bool RouterContext::findPath(const StateGrid &grid, const HananAxes &axes, const vector<Position> &sources, const vector<Position> &sinks, SearchMode mode) {
+    if (axes.unit()) return findPath(grid, sources, sinks, mode);
+    SearchWindow region = searchRegion(grid, sources);
+    prepare(region);
+    prepareDistances(region);
+    // dijkstra over the tracks, a step costs the real gap between them;
+    // every reached cell is labelled with the direction it was entered from
+    typedef pair<long long, size_t> Entry;
+    greater<Entry> later;
+    size_t width = grid.width();
+    _heap.clear();
+    _blockVisited = 0;
+    for (auto &p: sinks) {
+        if (_marks.inside(p.row, p.col)) _marks.set(p.row, p.col, MARK_SINK);
+    }
+    for (auto &p: sources) {
+        if (_labels.touched(p.row, p.col)) continue;
+        if (_marks.get(p.row, p.col) != MARK_SINK) _marks.set(p.row, p.col, MARK_SOURCE);
+        _heap.emplace_back(0, (size_t) p.col * width + p.row);
+        _dist.set(p.row, p.col, 0);
+        _labels.set(p.row, p.col, NumOfNbrs);
+        ++_blockVisited;
+    }
+    make_heap(_heap.begin(), _heap.end(), later);
+    while (!_heap.empty()) {
+        pop_heap(_heap.begin(), _heap.end(), later);
+        Entry top = _heap.back();
+        _heap.pop_back();
+        Position here(top.second % width, top.second / width);
+        if (top.first > _dist.get(here.row, here.col)) continue;
+        if (_marks.get(here.row, here.col) == MARK_SINK) {
+            if (top.first == 0) {
+                // a source that already is a sink
+                _marks.set(here.row, here.col, MARK_SOURCE);
+            }
+            tracePath(here, [this](Position cell) {
+                const Position &step = offset[_labels.get(cell.row, cell.col)];
+                return Position(cell.row - step.row, cell.col - step.col);
+            });
+            _wirelength = top.first;
+            return true;
+        }
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position nbr(here.row + offset[i].row, here.col + offset[i].col);
+            if (!inWindow(grid, nbr) || _labels.get(nbr.row, nbr.col) == SCRATCH_BLOCKED) {
+                continue;
+            }
+            if (!_labels.touched(nbr.row, nbr.col)) {
+                ++_blockVisited;
+                // if routable, the sinks always are
+                if (!cell_routable(grid(nbr.row, nbr.col)) && _marks.get(nbr.row, nbr.col) != MARK_SINK) {
+                    _labels.set(nbr.row, nbr.col, SCRATCH_BLOCKED);
+                    continue;
+                }
+            }
+            long long d = top.first + axes.step(here.row, here.col, nbr.row, nbr.col);
+            if (d < _dist.get(nbr.row, nbr.col)) {
+                _dist.set(nbr.row, nbr.col, d);
+                _labels.set(nbr.row, nbr.col, i);
+                _heap.emplace_back(d, (size_t) nbr.col * width + nbr.row);
+                push_heap(_heap.begin(), _heap.end(), later);
+            }
+        }
+    }
+    _pathLength = INT32_MAX;
+    _wirelength = INT64_MAX;
+    return false;
+}
+
+bool RouterContext::findPath(const StateGrid &grid, TileGraph &tiles, const vector<Position> &sources, const vector<Position> &sinks, SearchMode mode) {
+    _unitAxes.build_unit(grid.width(), grid.height());
+    return findPath(grid, _unitAxes, tiles, sources, sinks, mode);
+}
+
+bool RouterContext::findPath(const StateGrid &grid, const HananAxes &axes, TileGraph &tiles, const vector<Position> &sources, const vector<Position> &sinks, SearchMode mode) {
+    // sinks are entered even when blocked, so a tile chain can miss paths that end in one
+    if (!tiles.route(sources, sinks, CORRIDOR_HALO, _tileCorridor)) return findPath(grid, axes, sources, sinks, mode);
+    setCorridor(&_tileCorridor, tiles.tileSize());
+    bool found = findPath(grid, axes, sources, sinks, mode);
+    setCorridor(nullptr, 1);
+    if (found) return true;
+    // the tiles only count free cells, they can still be cut off inside
+    int visited = _blockVisited;
+    found = findPath(grid, axes, sources, sinks, mode);
+    _blockVisited += visited;
+    return found;
+}
+
+bool RouterContext::searchWindowed(const StateGrid &grid, const HananAxes &axes, Position start, Position finish) {
+    SearchWindow outer = _window;
+    int xMin = min(start.row, finish.row), xMax = max(start.row, finish.row);
+    int yMin = min(start.col, finish.col), yMax = max(start.col, finish.col);
+    long long manhattan = (long long) axes.x(xMax) - axes.x(xMin) + axes.y(yMax) - axes.y(yMin);
+    int visited = 0;
+    bool found;
+    for (int margin = FIRST_WINDOW_MARGIN;; margin *= 2) {
+        SearchWindow window(max(xMin - margin, max(outer.xMin, 0)), max(yMin - margin, max(outer.yMin, 0)),
+                            min(xMax + margin, min(outer.xMax, grid.width() - 1)), min(yMax + margin, min(outer.yMax, grid.height() - 1)));
+        _window = window;
+        _sources.assign(1, start);
+        _sinks.assign(1, finish);
+        found = findPath(grid, axes, _sources, _sinks);
+        visited += _blockVisited;
+        // a path that leaves the window has to reach a track outside it and come back,
+        // so it is longer than the manhattan distance by twice the nearest such detour
+        long long detour = INT64_MAX;
+        if (window.xMin > max(outer.xMin, 0)) detour = min(detour, (long long) axes.x(xMin) - axes.x(window.xMin - 1));
+        if (window.yMin > max(outer.yMin, 0)) detour = min(detour, (long long) axes.y(yMin) - axes.y(window.yMin - 1));
+        if (window.xMax < min(outer.xMax, grid.width() - 1)) detour = min(detour, (long long) axes.x(window.xMax + 1) - axes.x(xMax));
+        if (window.yMax < min(outer.yMax, grid.height() - 1)) detour = min(detour, (long long) axes.y(window.yMax + 1) - axes.y(yMax));
+        if (detour == INT64_MAX || (found && _wirelength <= manhattan + 2 * detour)) break;
+    }
+    _window = outer;
+    _blockVisited = visited;
+    return found;
+}
+
+bool RouterContext::searchAStar(const StateGrid &grid, const HananAxes &axes, Position start, Position finish) {
+    prepare(grid);
+    prepareDistances(grid);
+    // the manhattan distance never overestimates, so the finish is final when it is popped;
+    // among equal estimates the deeper cell goes first
+    auto estimate = [&](Position p) {
+        return (long long) abs(axes.x(p.row) - axes.x(finish.row)) + abs(axes.y(p.col) - axes.y(finish.col));
+    };
+    auto later = [](const OpenEntry &e1, const OpenEntry &e2) {
+        return e1.f != e2.f ? e1.f > e2.f : e1.g < e2.g;
+    };
+    size_t width = grid.width();
+    _open.clear();
+    _open.push_back({estimate(start), 0, (size_t) start.col * width + start.row});
+    _marks.set(start.row, start.col, MARK_SOURCE);
+    _dist.set(start.row, start.col, 0);
+    _labels.set(start.row, start.col, NumOfNbrs);
+    _blockVisited = 1;
+    while (!_open.empty()) {
+        pop_heap(_open.begin(), _open.end(), later);
+        OpenEntry top = _open.back();
+        _open.pop_back();
+        Position here(top.key % width, top.key / width);
+        if (top.g > _dist.get(here.row, here.col)) continue;
+        if (here == finish) {
+            tracePath(here, [this](Position cell) {
+                const Position &step = offset[_labels.get(cell.row, cell.col)];
+                return Position(cell.row - step.row, cell.col - step.col);
+            });
+            _wirelength = top.g;
+            return true;
+        }
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position nbr(here.row + offset[i].row, here.col + offset[i].col);
+            if (!grid.inside(nbr.row, nbr.col) || _labels.get(nbr.row, nbr.col) == SCRATCH_BLOCKED) {
+                continue;
+            }
+            if (!_labels.touched(nbr.row, nbr.col)) {
+                ++_blockVisited;
+                // if routable, the finish always is
+                if (!cell_routable(grid(nbr.row, nbr.col)) && !(nbr == finish)) {
+                    _labels.set(nbr.row, nbr.col, SCRATCH_BLOCKED);
+                    continue;
+                }
+            }
+            long long d = top.g + axes.step(here.row, here.col, nbr.row, nbr.col);
+            if (d < _dist.get(nbr.row, nbr.col)) {
+                _dist.set(nbr.row, nbr.col, d);
+                _labels.set(nbr.row, nbr.col, i);
+                _open.push_back({d + estimate(nbr), d, (size_t) nbr.col * width + nbr.row});
+                push_heap(_open.begin(), _open.end(), later);
+            }
+        }
+    }
+    _pathLength = INT32_MAX;
+    _wirelength = INT64_MAX;
+    return false;
+}
+
+bool RouterContext::searchParallel(const StateGrid &grid, Position start, Position finish) {
+    size_t cells = (size_t) grid.width() * grid.height();
+    if (_waveCells != cells) {
+        _waveMarks.reset(new atomic<uint32_t>[cells]);
+        for (size_t i = 0; i < cells; ++i) _waveMarks[i].store(0, memory_order_relaxed);
+        _waveCells = cells;
+        _waveEpoch = 0;
+    }
+    if (++_waveEpoch == MAX_WAVE_EPOCH) {
+        for (size_t i = 0; i < cells; ++i) _waveMarks[i].store(0, memory_order_relaxed);
+        _waveEpoch = 1;
+    }
+    const uint32_t epoch = _waveEpoch << 2;
+    size_t width = grid.width();
+    auto mark = [&](int x, int y) -> atomic<uint32_t> & {
+        return _waveMarks[(size_t) y * width + x];
+    };
+    _path.clear();
+    if (start == finish) {
+        _path.push_back(start);
+        _pathLength = 0;
+        _wirelength = 0;
+        _blockVisited = 1;
+        return true;
+    }
+    mark(start.row, start.col).store(epoch, memory_order_relaxed);
+    _frontier.assign(1, start);
+    // box of the reached cells, a bottom-up level only looks one cell around it
+    int xMin = start.row, xMax = start.row, yMin = start.col, yMax = start.col;
+    long long reachedCells = 1;
+    atomic<int> visited(1);
+    atomic<bool> found(false);
+    atomic<size_t> nextTask(0);
+    // started on the first level large enough to share
+    unique_ptr<ThreadTeam> team;
+    uint32_t level = 0;
+    bool bottomUp = false;
+    int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+    // top-down: every frontier cell claims its unvisited neighbours, the first claim wins
+    // bottom-up: every unvisited cell in the box joins when a neighbour is in the frontier
+    function<void(unsigned)> step = [&](unsigned worker) {
+        vector<Position> &next = _nextFrontiers[worker];
+        const uint32_t current = epoch | (level % 3), label = epoch | ((level + 1) % 3);
+        int looked = 0;
+        if (!bottomUp) {
+            size_t n = _frontier.size();
+            for (size_t begin = nextTask.fetch_add(WAVE_CHUNK); begin < n; begin = nextTask.fetch_add(WAVE_CHUNK)) {
+                for (size_t k = begin; k < min(begin + WAVE_CHUNK, n); ++k) {
+                    const Position &here = _frontier[k];
+                    for (int i = 0; i < NumOfNbrs; i++) {
+                        Position nbr(here.row + offset[i].row, here.col + offset[i].col);
+                        if (!inWindow(grid, nbr)) continue;
+                        bool sink = nbr == finish;
+                        if (!sink && !cell_routable(grid(nbr.row, nbr.col))) continue;
+                        ++looked;
+                        atomic<uint32_t> &cell = mark(nbr.row, nbr.col);
+                        uint32_t old = cell.load(memory_order_relaxed);
+                        if ((old & ~3u) == epoch || !cell.compare_exchange_strong(old, label, memory_order_relaxed)) continue;
+                        next.push_back(nbr);
+                        if (sink) found.store(true, memory_order_relaxed);
+                    }
+                }
+            }
+        } else {
+            // an unvisited cell next to a reached one can only be next to the frontier,
+            // anything older would have reached it already
+            for (size_t y = y0 + nextTask.fetch_add(1); y <= (size_t) y1; y = y0 + nextTask.fetch_add(1)) {
+                for (int x = x0; x <= x1; ++x) {
+                    Position here(x, y);
+                    if (!inWindow(grid, here)) continue;
+                    bool sink = here == finish;
+                    if (!sink && !cell_routable(grid(x, y))) continue;
+                    atomic<uint32_t> &cell = mark(x, y);
+                    if ((cell.load(memory_order_relaxed) & ~3u) == epoch) continue;
+                    ++looked;
+                    for (int i = 0; i < NumOfNbrs; i++) {
+                        Position nbr(x + offset[i].row, y + offset[i].col);
+                        if (!grid.inside(nbr.row, nbr.col) || mark(nbr.row, nbr.col).load(memory_order_relaxed) != current) continue;
+                        cell.store(label, memory_order_relaxed);
+                        next.push_back(here);
+                        if (sink) found.store(true, memory_order_relaxed);
+                        break;
+                    }
+                }
+            }
+        }
+        visited += looked;
+    };
+    while (!_frontier.empty() && !found) {
+        x0 = max(xMin - 1, 0), x1 = min(xMax + 1, grid.width() - 1);
+        y0 = max(yMin - 1, 0), y1 = min(yMax + 1, grid.height() - 1);
+        long long box = (long long) (x1 - x0 + 1) * (y1 - y0 + 1);
+        bottomUp = (long long) _frontier.size() * BOTTOM_UP_FACTOR > box - reachedCells;
+        size_t work = bottomUp ? box : _frontier.size() * NumOfNbrs;
+        unsigned threads = 1;
+        if (work >= PARALLEL_LEVEL_CELLS && _numThreads != 1) {
+            if (!team) team.reset(new ThreadTeam(_numThreads));
+            threads = team->size();
+        }
+        if (_nextFrontiers.size() < threads) _nextFrontiers.resize(threads);
+        for (unsigned w = 0; w < threads; ++w) _nextFrontiers[w].clear();
+        nextTask = 0;
+        if (threads > 1) team->run(step);
+        else step(0);
+        _frontier.clear();
+        for (unsigned w = 0; w < threads; ++w) {
+            for (auto &p: _nextFrontiers[w]) {
+                xMin = min(xMin, p.row);
+                xMax = max(xMax, p.row);
+                yMin = min(yMin, p.col);
+                yMax = max(yMax, p.col);
+            }
+            _frontier.insert(_frontier.end(), _nextFrontiers[w].begin(), _nextFrontiers[w].end());
+        }
+        reachedCells += _frontier.size();
+        ++level;
+    }
+    _blockVisited = visited;
+    if (!found) {
+        _pathLength = INT32_MAX;
+        _wirelength = INT64_MAX;
+        return false;
+    }
+    // distances are the same whatever thread reached a cell, so walking back the labels
+    // gives the path of the BFS
+    Position here = finish;
+    for (uint32_t label = level % 3; !(here == start); label = (label + 2) % 3) {
+        _path.push_back(here);
+        uint32_t previous = epoch | ((label + 2) % 3);
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position next(here.row + offset[i].row, here.col + offset[i].col);
+            if (grid.inside(next.row, next.col) && mark(next.row, next.col).load(memory_order_relaxed) == previous) {
+                here = next;
+                break;
+            }
+        }
+    }
+    _pathLength = _path.size();
+    _wirelength = _pathLength;
+    reverse(_path.begin(), _path.end());
+    _path.push_back(start);
+    return true;
+}
+
+bool RouterContext::searchBidirectional(const StateGrid &grid, Position start, Position finish) {
+    prepare(grid);
+    prepareDistances(grid);
+    _blockVisited = 1;
+    if (start == finish) {
+        _path.push_back(start);
+        _pathLength = 0;
+        _wirelength = 0;
+        return true;
+    }
+    // a cell belongs to the wave that reached it first and is labelled with the
+    // direction it was entered from, BACKWARD set for the wave of the finish
+    _labels.set(start.row, start.col, NumOfNbrs);
+    _dist.set(start.row, start.col, 0);
+    _queue.push(start);
+    _labels.set(finish.row, finish.col, BACKWARD | NumOfNbrs);
+    _dist.set(finish.row, finish.col, 0);
+    _backQueue.push(finish);
+    ++_blockVisited;
+    long long best = INT64_MAX;
+    Position meetForward, meetBackward;
+    while (!_queue.empty() && !_backQueue.empty()) {
+        // grow the smaller wave by one whole level, the shortest meeting
+        // found in the level the waves first touch is the shortest path
+        bool forward = _queue.size() <= _backQueue.size();
+        RingQueue<Position> &frontier = forward ? _queue : _backQueue;
+        uint8_t side = forward ? 0 : BACKWARD;
+        for (size_t n = frontier.size(); n > 0; --n) {
+            Position here = frontier.front();
+            frontier.pop();
+            for (int i = 0; i < NumOfNbrs; i++) {
+                Position nbr(here.row + offset[i].row, here.col + offset[i].col);
+                if (!grid.inside(nbr.row, nbr.col)) {
+                    continue;
+                }
+                uint8_t label = _labels.get(nbr.row, nbr.col);
+                if (label == SCRATCH_BLOCKED) {
+                    continue;
+                }
+                if (_labels.touched(nbr.row, nbr.col)) {
+                    if ((label & BACKWARD) != side) {
+                        long long total = _dist.get(here.row, here.col) + 1 + _dist.get(nbr.row, nbr.col);
+                        if (total < best) {
+                            best = total;
+                            meetForward = forward ? here : nbr;
+                            meetBackward = forward ? nbr : here;
+                        }
+                    }
+                    continue;
+                }
+                ++_blockVisited;
+                if (!cell_routable(grid(nbr.row, nbr.col))) {
+                    _labels.set(nbr.row, nbr.col, SCRATCH_BLOCKED);
+                    continue;
+                }
+                _labels.set(nbr.row, nbr.col, side | i);
+                _dist.set(nbr.row, nbr.col, _dist.get(here.row, here.col) + 1);
+                frontier.push(nbr);
+            }
+        }
+        if (best != INT64_MAX) {
+            // finish back to the meeting point, then the meeting point back to the start
+            Position cell = meetBackward;
+            while (true) {
+                _path.push_back(cell);
+                if (cell == finish) break;
+                const Position &step = offset[_labels.get(cell.row, cell.col) & ~BACKWARD];
+                cell = Position(cell.row - step.row, cell.col - step.col);
+            }
+            reverse(_path.begin(), _path.end());
+            for (cell = meetForward; !(cell == start);) {
+                _path.push_back(cell);
+                const Position &step = offset[_labels.get(cell.row, cell.col)];
+                cell = Position(cell.row - step.row, cell.col - step.col);
+            }
+            reverse(_path.begin(), _path.end());
+            _pathLength = _path.size();
+            _wirelength = _pathLength;
+            _path.push_back(start);
+            return true;
+        }
+    }
+    _pathLength = INT32_MAX;
+    _wirelength = INT64_MAX;
+    return false;
+}
+
+bool RouterContext::searchBitwave(const StateGrid &grid, Position start, Position finish) {
+    prepare(grid);
+    _blockVisited = 1;
+    if (start == finish) {
+        _path.push_back(start);
+        _pathLength = 0;
+        _wirelength = 0;
+        return true;
+    }
+    // bit x % 64 of word y * stride + x / 64 is cell (x, y); every row ends in
+    // at least one blocked padding bit, so carries never reach the next row
+    int width = grid.width(), height = grid.height();
+    size_t stride = width / 64 + 1;
+    size_t words = stride * height;
+    _free.assign(words, 0);
+    _seen.assign(words, 0);
+    _front.assign(words, 0);
+    _next.assign(words, 0);
+    _layerLow.assign(words, 0);
+    _layerHigh.assign(words, 0);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *cells = grid.row(y);
+        uint64_t *bits = &_free[y * stride];
+        for (int x = 0; x < width; ++x) {
+            bits[x >> 6] |= (uint64_t) cell_routable(cells[x]) << (x & 63);
+        }
+    }
+    size_t finishWord = finish.col * stride + (finish.row >> 6);
+    uint64_t finishBit = (uint64_t) 1 << (finish.row & 63);
+    // the finish always is routable
+    _free[finishWord] |= finishBit;
+    size_t startWord = start.col * stride + (start.row >> 6);
+    _front[startWord] = _seen[startWord] = (uint64_t) 1 << (start.row & 63);
+    _active.assign(1, startWord);
+    _marks.set(start.row, start.col, MARK_SOURCE);
+
+    auto spread = [&](size_t word, uint64_t bits) {
+        if (bits == 0) return;
+        if (_next[word] == 0) _nextActive.push_back(word);
+        _next[word] |= bits;
+    };
+    for (int level = 1; !_active.empty(); ++level) {
+        // every front word reaches its row neighbours by shifts, with the carries
+        // going to the words beside it, and the rows above and below as they are
+        _nextActive.clear();
+        for (size_t word: _active) {
+            uint64_t bits = _front[word];
+            _front[word] = 0;
+            spread(word, (bits << 1) | (bits >> 1));
+            if (word + 1 < words) spread(word + 1, bits >> 63);
+            if (word > 0) spread(word - 1, bits << 63);
+            if (word >= stride) spread(word - stride, bits);
+            if (word + stride < words) spread(word + stride, bits);
+        }
+        _active.clear();
+        // the distance mod 3 of the new cells goes into two bit planes
+        uint64_t low = level % 3 == 1 ? ~(uint64_t) 0 : 0;
+        uint64_t high = level % 3 == 2 ? ~(uint64_t) 0 : 0;
+        bool reached = false;
+        for (size_t word: _nextActive) {
+            uint64_t bits = _next[word] & _free[word] & ~_seen[word];
+            _next[word] = 0;
+            if (bits == 0) continue;
+            _seen[word] |= bits;
+            _layerLow[word] |= bits & low;
+            _layerHigh[word] |= bits & high;
+            _front[word] = bits;
+            _active.push_back(word);
+            _blockVisited += __builtin_popcountll(bits);
+            if (word == finishWord && (bits & finishBit)) reached = true;
+        }
+        if (reached) break;
+    }
+    if (!(_seen[finishWord] & finishBit)) {
+        _pathLength = INT32_MAX;
+        _wirelength = INT64_MAX;
+        return false;
+    }
+    // same walk as traceLayers, reading the labels from the bit planes
+    auto layer = [&](Position cell) {
+        if (cell.row < 0 || cell.row >= width || cell.col < 0 || cell.col >= height) return -1;
+        size_t word = cell.col * stride + (cell.row >> 6);
+        int bit = cell.row & 63;
+        if (!((_seen[word] >> bit) & 1)) return -1;
+        return (int) ((_layerLow[word] >> bit) & 1) | (int) ((_layerHigh[word] >> bit) & 1) << 1;
+    };
+    tracePath(finish, [&](Position cell) {
+        int previous = (layer(cell) + 2) % 3;
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position next(cell.row + offset[i].row, cell.col + offset[i].col);
+            if (layer(next) == previous) return next;
+        }
+        return cell;
+    });
+    _wirelength = _pathLength;
+    return true;
+}
+
+bool RouterContext::addProbeLine(const StateGrid &grid, Position origin, bool horizontal, int parent, int side, Position &meet, int &other) {
+    // cells carry one bit per side and direction of the lines through them,
+    // lines are maximal so a covered origin means the line already exists
+    uint8_t bit = 1 << (side * 2 + horizontal);
+    auto covered = [this](Position cell) {
+        return _labels.touched(cell.row, cell.col) ? _labels.get(cell.row, cell.col) : 0;
+    };
+    if (covered(origin) & bit) return false;
+    ProbeLine line;
+    line.horizontal = horizontal;
+    line.fixed = horizontal ? origin.col : origin.row;
+    line.origin = origin;
+    line.parent = parent;
+    line.side = side;
+    auto cellAt = [&](int t) {
+        return horizontal ? Position(t, line.fixed) : Position(line.fixed, t);
+    };
+    auto free = [&](int t) {
+        Position cell = cellAt(t);
+        return grid.inside(cell.row, cell.col) && cell_routable(grid(cell.row, cell.col));
+    };
+    int at = horizontal ? origin.row : origin.col;
+    line.lo = line.hi = at;
+    while (free(line.lo - 1)) --line.lo;
+    while (free(line.hi + 1)) ++line.hi;
+    for (int t = line.lo; t <= line.hi; ++t) {
+        Position cell = cellAt(t);
+        _labels.set(cell.row, cell.col, covered(cell) | bit);
+        ++_blockVisited;
+    }
+    _lines.push_back(line);
+    for (size_t i = 0; i + 1 < _lines.size(); ++i) {
+        const ProbeLine &o = _lines[i];
+        if (o.side == side) continue;
+        if (o.horizontal != horizontal) {
+            // crossing point of the row and the column
+            int x = horizontal ? o.fixed : line.fixed;
+            int y = horizontal ? line.fixed : o.fixed;
+            int along = horizontal ? x : y, across = horizontal ? y : x;
+            if (along < line.lo || along > line.hi || across < o.lo || across > o.hi) continue;
+            meet = Position(x, y);
+        } else {
+            // the same row or column, overlapping
+            if (o.fixed != line.fixed || max(o.lo, line.lo) > min(o.hi, line.hi)) continue;
+            meet = cellAt(min(max(at, o.lo), o.hi));
+        }
+        other = i;
+        return true;
+    }
+    return false;
+}
+
+void RouterContext::traceProbe(int line, int other, Position meet) {
+    if (_lines[line].side == 1) swap(line, other);
+    // start, the origins down to the line of the start side, the meeting point,
+    // then the origins up from the line of the finish side to the finish
+    _corners.clear();
+    for (int l = line; l >= 0; l = _lines[l].parent) _corners.push_back(_lines[l].origin);
+    reverse(_corners.begin(), _corners.end());
+    _corners.push_back(meet);
+    for (int l = other; l >= 0; l = _lines[l].parent) _corners.push_back(_lines[l].origin);
+    // walk the corners cell by cell; stepping on a cell already on the path cuts the loop,
+    // _dist holds the 1-based index of every path cell and 0 for the start
+    Position start = _corners.front();
+    _path.clear();
+    _dist.set(start.row, start.col, 0);
+    Position here = start;
+    for (auto &corner: _corners) {
+        while (!(here == corner)) {
+            here.row += (corner.row > here.row) - (corner.row < here.row);
+            here.col += (corner.col > here.col) - (corner.col < here.col);
+            long long index = _dist.get(here.row, here.col);
+            if (index <= (long long) _path.size() && (index == 0 ? here == start : _path[index - 1] == here)) {
+                _path.resize(index);
+            } else {
+                _path.push_back(here);
+                _dist.set(here.row, here.col, _path.size());
+            }
+        }
+    }
+    _pathLength = _path.size();
+    _wirelength = _pathLength;
+    _path.push_back(start);
+}
+
+bool RouterContext::searchLineProbe(const StateGrid &grid, Position start, Position finish) {
+    prepare(grid);
+    prepareDistances(grid);
+    _blockVisited = 0;
+    if (start == finish) {
+        _path.push_back(start);
+        _pathLength = 0;
+        _wirelength = 0;
+        _blockVisited = 1;
+        return true;
+    }
+    // Mikami-Tabuchi levels: the rows and columns through both terminals, then
+    // perpendicular lines from the escape points of the previous level, until a
+    // line of the start meets a line of the finish
+    _lines.clear();
+    Position meet;
+    int other;
+    if (addProbeLine(grid, start, true, -1, 0, meet, other) || addProbeLine(grid, start, false, -1, 0, meet, other) ||
+        addProbeLine(grid, finish, true, -1, 1, meet, other) || addProbeLine(grid, finish, false, -1, 1, meet, other)) {
+        traceProbe(_lines.size() - 1, other, meet);
+        return true;
+    }
+    for (size_t begin = 0; begin < _lines.size() && _lines.size() < MAX_PROBE_LINES;) {
+        size_t end = _lines.size();
+        for (size_t l = begin; l < end && _lines.size() < MAX_PROBE_LINES; ++l) {
+            ProbeLine line = _lines[l];
+            // escape points: both ends, the cells beside obstacle corners and the
+            // one in line with the other terminal
+            Position target = line.side == 0 ? finish : start;
+            int aligned = line.horizontal ? target.row : target.col;
+            auto beside = [&](int t, int d) {
+                Position cell = line.horizontal ? Position(t, line.fixed + d) : Position(line.fixed + d, t);
+                return grid.inside(cell.row, cell.col) && cell_routable(grid(cell.row, cell.col));
+            };
+            for (int t = line.lo; t <= line.hi; ++t) {
+                bool escape = t == line.lo || t == line.hi || t == aligned;
+                for (int d = -1; d <= 1 && !escape; d += 2) {
+                    escape = beside(t, d) && (!beside(t - 1, d) || !beside(t + 1, d));
+                }
+                if (!escape) continue;
+                Position origin = line.horizontal ? Position(t, line.fixed) : Position(line.fixed, t);
+                if (addProbeLine(grid, origin, !line.horizontal, l, line.side, meet, other)) {
+                    traceProbe(_lines.size() - 1, other, meet);
+                    return true;
+                }
+            }
+        }
+        begin = end;
+    }
+    // the escape points missed a way through, the BFS finds it if there is one
+    int probed = _blockVisited;
+    _sources.assign(1, start);
+    _sinks.assign(1, finish);
+    bool found = findPath(grid, _sources, _sinks);
+    _blockVisited += probed;
+    return found;
+}
+
+bool RouterContext::searchCongestion(const StateGrid &grid, const vector<Position> &sources, const vector<Position> &sinks) {
+    SearchWindow region = searchRegion(grid, sources);
+    prepare(region);
+    _stateDist.fit(region.xMin * 2, region.yMin, _labels.width() * 2, _labels.height());
+    _stateFrom.fit(region.xMin * 2, region.yMin, _labels.width() * 2, _labels.height());
+    int width = grid.width();
+    _buckets.clear();
+    _blockVisited = 0;
+    // a state is a cell and the orientation it was entered with, so turning can
+    // cost extra; from holds the direction of the last step and the orientation
+    // of the state it came from, sources have none
+    const uint8_t FROM_SOURCE = 0xFF;
+    auto state = [width](Position cell, int orientation) {
+        return ((size_t) cell.col * width + cell.row) * 2 + orientation;
+    };
+    for (auto &p: sinks) {
+        if (_marks.inside(p.row, p.col)) _marks.set(p.row, p.col, MARK_SINK);
+    }
+    for (auto &p: sources) {
+        if (_marks.get(p.row, p.col) != MARK_SINK) _marks.set(p.row, p.col, MARK_SOURCE);
+        // the first step never counts as a turn, so one orientation will do
+        _stateDist.set(p.row * 2, p.col, 0);
+        _stateFrom.set(p.row * 2, p.col, FROM_SOURCE);
+        _buckets.push(0, state(p, 0));
+    }
+    auto cellCost = [&](Position cell) {
+        int cost = 1;
+        if (_costs.congestion) cost += (*_costs.congestion)(cell.row, cell.col);
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position next(cell.row + offset[i].row, cell.col + offset[i].col);
+            if (grid.inside(next.row, next.col) && grid(next.row, next.col) == CELL_OTHER_NET) {
+                cost += _costs.nearNet;
+                break;
+            }
+        }
+        return cost;
+    };
+    while (!_buckets.empty()) {
+        size_t key;
+        long long d = _buckets.pop(key);
+        int orientation = key & 1;
+        Position here((key >> 1) % width, (key >> 1) / width);
+        if (d > _stateDist.get(here.row * 2 + orientation, here.col)) continue;
+        ++_blockVisited;
+        if (_marks.get(here.row, here.col) == MARK_SINK) {
+            if (_stateFrom.get(here.row * 2 + orientation, here.col) == FROM_SOURCE) {
+                // a source that already is a sink
+                _marks.set(here.row, here.col, MARK_SOURCE);
+            }
+            tracePath(here, [&](Position cell) {
+                uint8_t from = _stateFrom.get(cell.row * 2 + orientation, cell.col);
+                orientation = from >> 2;
+                return Position(cell.row - offset[from & 3].row, cell.col - offset[from & 3].col);
+            });
+            _wirelength = _pathLength;
+            return true;
+        }
+        for (int i = 0; i < NumOfNbrs; i++) {
+            Position nbr(here.row + offset[i].row, here.col + offset[i].col);
+            if (!inWindow(grid, nbr)) continue;
+            // if routable, the sinks always are
+            if (!cell_routable(grid(nbr.row, nbr.col)) && _marks.get(nbr.row, nbr.col) != MARK_SINK) continue;
+            int turn = i & 1;
+            long long nd = d + cellCost(nbr) + (turn != orientation && _stateFrom.get(here.row * 2 + orientation, here.col) != FROM_SOURCE ? _costs.bend : 0);
+            if (nd < _stateDist.get(nbr.row * 2 + turn, nbr.col)) {
+                _stateDist.set(nbr.row * 2 + turn, nbr.col, nd);
+                _stateFrom.set(nbr.row * 2 + turn, nbr.col, i | orientation << 2);
+                _buckets.push(nd, state(nbr, turn));
+            }
+        }
+    }
+    _pathLength = INT32_MAX;
+    _wirelength = INT64_MAX;
+    return false;
+}
@@ -0,0 +1,343 @@
+#ifndef _ROUTER_H
+#define _ROUTER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include "findPath.h"
+#include "grid.h"
+#include "hanan.h"
+#include "tileGraph.h"
+
+// FIFO over a growable power-of-two ring, popping never releases memory
+// so a queue that is cleared and refilled stops allocating after warm-up.
+template<typename T>
+class RingQueue {
+public:
+    RingQueue() : _head(0), _size(0) {}
+
+    ~RingQueue() {}
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    void clear() {
+        _head = 0;
+        _size = 0;
+    }
+
+    // makes room for n elements without growing on push
+    void reserve(size_t n) {
+        if (n > _buffer.size()) grow(n);
+    }
+
+    void push(const T &value) {
+        if (_size == _buffer.size()) grow(_size + 1);
+        _buffer[(_head + _size) & (_buffer.size() - 1)] = value;
+        ++_size;
+    }
+
+    const T &front() const {
+        return _buffer[_head];
+    }
+
+    void pop() {
+        _head = (_head + 1) & (_buffer.size() - 1);
+        --_size;
+    }
+
+private:
+    void grow(size_t n) {
+        size_t capacity = _buffer.empty() ? 64 : _buffer.size();
+        while (capacity < n) capacity <<= 1;
+        std::vector<T> buffer(capacity);
+        for (size_t i = 0; i < _size; ++i) buffer[i] = _buffer[(_head + i) & (_buffer.size() - 1)];
+        _buffer.swap(buffer);
+        _head = 0;
+    }
+
+    std::vector<T> _buffer;
+    size_t _head, _size;
+};
+
+// Monotone priority queue of integer keys (Dial): one bucket per key in a
+// ring that grows to the largest key spread seen, so push and pop are O(1)
+// as long as the keys popped never decrease.
+template<typename T>
+class BucketQueue {
+public:
+    BucketQueue() : _base(0), _size(0) {}
+
+    ~BucketQueue() {}
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    // only walks the buckets up to the last one still holding keys
+    void clear() {
+        for (long long key = _base; _size > 0; ++key) {
+            std::vector<T> &bucket = _buckets[key & (_buckets.size() - 1)];
+            _size -= bucket.size();
+            bucket.clear();
+        }
+        _base = 0;
+    }
+
+    // key must not be smaller than the last key popped
+    void push(long long key, const T &value) {
+        if (key - _base >= (long long) _buckets.size()) grow(key - _base + 1);
+        _buckets[key & (_buckets.size() - 1)].push_back(value);
+        ++_size;
+    }
+
+    // smallest key, the value goes to value
+    long long pop(T &value) {
+        while (_buckets[_base & (_buckets.size() - 1)].empty()) ++_base;
+        std::vector<T> &bucket = _buckets[_base & (_buckets.size() - 1)];
+        value = bucket.back();
+        bucket.pop_back();
+        --_size;
+        return _base;
+    }
+
+private:
+    void grow(long long spread) {
+        size_t capacity = _buckets.empty() ? 16 : _buckets.size();
+        while (capacity < (size_t) spread) capacity <<= 1;
+        std::vector<std::vector<T>> buckets(capacity);
+        for (size_t i = 0; i < _buckets.size(); ++i) {
+            long long key = _base + ((i - _base) & (_buckets.size() - 1));
+            buckets[key & (capacity - 1)].swap(_buckets[i]);
+        }
+        _buckets.swap(buckets);
+    }
+
+    std::vector<std::vector<T>> _buckets;
+    long long _base;
+    size_t _size;
+};
+
+// integer costs of the congestion-aware search on top of 1 per step
+struct RouteCosts {
+    int nearNet; // entering a cell next to a wire of another net
+    int bend;    // turning
+    const Grid<uint16_t> *congestion; // extra cost of every cell, may be null
+
+    RouteCosts(int nearNet = 2, int bend = 1, const Grid<uint16_t> *congestion = nullptr)
+            : nearNet(nearNet), bend(bend), congestion(congestion) {}
+};
+
+// cells a search may enter, inclusive bounds in grid coordinates
+struct SearchWindow {
+    int xMin, yMin, xMax, yMax;
+
+    SearchWindow(int xMin = INT32_MIN, int yMin = INT32_MIN, int xMax = INT32_MAX, int yMax = INT32_MAX)
+            : xMin(xMin), yMin(yMin), xMax(xMax), yMax(yMax) {}
+
+    bool contains(int x, int y) const {
+        return x >= xMin && x <= xMax && y >= yMin && y <= yMax;
+    }
+
+    // true when no cell is in both windows
+    bool apart(const SearchWindow &other) const {
+        return xMax < other.xMin || other.xMax < xMin || yMax < other.yMin || other.yMax < yMin;
+    }
+};
+
+// how a single-pair search explores the grid, all but the line probe and the
+// congestion search return a shortest path
+enum SearchMode {
+    SEARCH_BFS,           // Lee wavefront, dijkstra on a Hanan grid
+    SEARCH_ASTAR,         // best first on distance plus manhattan distance to the finish
+    SEARCH_BIDIRECTIONAL, // waves from both ends until they meet, unit grids only
+    SEARCH_BITWAVE,       // Lee wavefront on row bitmaps, 64 cells per step, unit grids only
+    SEARCH_LINEPROBE,     // escape lines from both ends, the BFS when they never meet, unit grids only
+    SEARCH_CONGESTION,    // cheapest path under the RouteCosts, on a bucket queue, unit grids only
+    SEARCH_WINDOWED,      // BFS (dijkstra on a Hanan grid) in the box of the two ends plus a margin
+                          // that doubles until no path leaving the window could be shorter
+    SEARCH_PARALLEL       // Lee wavefront with large levels spread over threads, the same path
+                          // as the BFS, unit grids only
+};
+
+// Buffers of the maze router kept between searches: labels with epoch
+// stamps so clearing them is O(1), the wavefront queue and the path of the
+// last search. One context per thread; the buffers only cover what a search
+// can reach, the window of a windowed one, and only grow.
+class RouterContext {
+public:
+    RouterContext() : _corridor(nullptr), _corridorTile(1), _labels(0, 0, SCRATCH_UNSEEN), _dist(0, 0, INT64_MAX),
+                      _stateDist(0, 0, UINT32_MAX), _waveCells(0), _waveEpoch(0), _numThreads(0),
+                      _pathLength(0), _wirelength(0), _blockVisited(0) {}
+
+    ~RouterContext() {}
+
+    // shortest path from start to finish on the unit grid
+    bool findPath(const StateGrid &grid, Position start, Position finish, SearchMode mode = SEARCH_BFS);
+
+    // shortest path on the tracks of axes, a bidirectional search runs dijkstra there
+    bool findPath(const StateGrid &grid, const HananAxes &axes, Position start, Position finish, SearchMode mode = SEARCH_BFS);
+
+    // one wave seeded from every source that stops at the first sink it reaches,
+    // the shortest path between the two sets; sinks are entered even when blocked.
+    // SEARCH_CONGESTION gives the cheapest path instead, any other mode the BFS
+    bool findPath(const StateGrid &grid, const std::vector<Position> &sources, const std::vector<Position> &sinks, SearchMode mode = SEARCH_BFS);
+
+    bool findPath(const StateGrid &grid, const HananAxes &axes, const std::vector<Position> &sources, const std::vector<Position> &sinks, SearchMode mode = SEARCH_BFS);
+
+    // the same search kept to the corridor of tiles a route over tiles takes, tiles
+    // has to be built from grid; when the corridor holds no path the whole grid is searched
+    bool findPath(const StateGrid &grid, TileGraph &tiles, const std::vector<Position> &sources, const std::vector<Position> &sinks, SearchMode mode = SEARCH_BFS);
+
+    bool findPath(const StateGrid &grid, const HananAxes &axes, TileGraph &tiles, const std::vector<Position> &sources, const std::vector<Position> &sinks, SearchMode mode = SEARCH_BFS);
+
+    // costs of SEARCH_CONGESTION, the congestion grid has to outlive the searches
+    void setCosts(const RouteCosts &costs) {
+        _costs = costs;
+    }
+
+    // keeps the BFS, dijkstra and congestion searches inside window, sources
+    // outside it still start the wave; SearchWindow() lifts it
+    void setWindow(const SearchWindow &window) {
+        _window = window;
+    }
+
+    // keeps the same searches inside the tiles of tileSize cells marked in corridor,
+    // which has to outlive the searches; nullptr lifts it
+    void setCorridor(const Grid<uint8_t> *corridor, int tileSize) {
+        _corridor = corridor;
+        _corridorTile = tileSize;
+    }
+
+    // threads of SEARCH_PARALLEL, 0 = all cores
+    void setThreads(unsigned numThreads) {
+        _numThreads = numThreads;
+    }
+
+    // last path: path()[0] is next to the start, path()[pathLength() - 1] the finish
+    // and path()[pathLength()] the start itself, the source it came from for a wave
+    const std::vector<Position> &path() const {
+        return _path;
+    }
+
+    // steps of the last path
+    int pathLength() const {
+        return _pathLength;
+    }
+
+    // real length of the last path
+    long long wirelength() const {
+        return _wirelength;
+    }
+
+    // cells the last search looked at
+    int blockVisited() const {
+        return _blockVisited;
+    }
+private:
+    struct OpenEntry {
+        long long f, g; // estimated total and distance so far
+        size_t key;
+    };
+
+    // maximal free run through origin, in the row of y = fixed or the column of x = fixed
+    struct ProbeLine {
+        bool horizontal;
+        int fixed;
+        int lo, hi;
+        Position origin; // where it leaves its parent line, the terminal for the first lines
+        int parent;      // index in _lines, -1 for the lines through the terminals
+        int side;        // 0 grows from the start, 1 from the finish
+    };
+
+    bool inWindow(const StateGrid &grid, Position p) const {
+        return grid.inside(p.row, p.col) && _window.contains(p.row, p.col) &&
+               (!_corridor || (*_corridor)(p.row / _corridorTile, p.col / _corridorTile));
+    }
+
+    // cells the BFS, dijkstra and congestion searches can reach: the window inside the grid and the sources
+    SearchWindow searchRegion(const StateGrid &grid, const std::vector<Position> &sources) const;
+
+    // scratch of a search that stays in region, so a windowed search only needs the cells of its window
+    void prepare(const SearchWindow &region);
+
+    void prepare(const StateGrid &grid) {
+        prepare(SearchWindow(0, 0, grid.width() - 1, grid.height() - 1));
+    }
+
+    void prepareDistances(const SearchWindow &region);
+
+    void prepareDistances(const StateGrid &grid) {
+        prepareDistances(SearchWindow(0, 0, grid.width() - 1, grid.height() - 1));
+    }
+
+    bool searchAStar(const StateGrid &grid, const HananAxes &axes, Position start, Position finish);
+
+    bool searchBidirectional(const StateGrid &grid, Position start, Position finish);
+
+    bool searchBitwave(const StateGrid &grid, Position start, Position finish);
+
+    bool searchLineProbe(const StateGrid &grid, Position start, Position finish);
+
+    bool searchWindowed(const StateGrid &grid, const HananAxes &axes, Position start, Position finish);
+
+    bool searchParallel(const StateGrid &grid, Position start, Position finish);
+
+    bool searchCongestion(const StateGrid &grid, const std::vector<Position> &sources, const std::vector<Position> &sinks);
+
+    // adds the line through origin unless the same side already has it, true when it meets the other side
+    bool addProbeLine(const StateGrid &grid, Position origin, bool horizontal, int parent, int side, Position &meet, int &other);
+
+    // fills _path along the corners of the two lines that met and their parents
+    void traceProbe(int line, int other, Position meet);
+
+    // fills _path by walking parent(cell) back from the finish to a source
+    template<typename Parent>
+    void tracePath(Position finish, Parent parent);
+
+    // tracePath over distance labels kept mod 3
+    void traceLayers(Position finish);
+
+    SearchWindow _window;
+    const Grid<uint8_t> *_corridor;
+    int _corridorTile;
+    Grid<uint8_t> _tileCorridor; // corridor of the last tiled search
+    EpochGrid<uint8_t> _labels;
+    EpochGrid<uint8_t> _marks; // sources and sinks of the current search
+    std::vector<Position> _sources, _sinks;
+    EpochGrid<long long> _dist;
+    RingQueue<Position> _queue, _backQueue;
+    std::vector<std::pair<long long, size_t>> _heap;
+    std::vector<OpenEntry> _open;
+    HananAxes _unitAxes;
+    // bitmaps of the bit-parallel wave, one bit per cell and rows padded to whole words
+    std::vector<uint64_t> _free, _seen, _front, _next;
+    std::vector<uint64_t> _layerLow, _layerHigh; // distance mod 3 of the seen cells
+    std::vector<size_t> _active, _nextActive; // words of _front and _next that hold cells
+    std::vector<ProbeLine> _lines;
+    std::vector<Position> _corners;
+    // congestion search states: a cell entered along y (0) or x (1), at x * 2 + orientation
+    RouteCosts _costs;
+    EpochGrid<uint32_t> _stateDist;
+    EpochGrid<uint8_t> _stateFrom;
+    BucketQueue<size_t> _buckets;
+    // parallel wave: a reached cell holds its epoch shifted left by 2 and its distance mod 3
+    std::unique_ptr<std::atomic<uint32_t>[]> _waveMarks;
+    size_t _waveCells;
+    uint32_t _waveEpoch;
+    unsigned _numThreads;
+    std::vector<Position> _frontier;
+    std::vector<std::vector<Position>> _nextFrontiers; // cells each thread reached in the current level
+    std::vector<Position> _path;
+    int _pathLength;
+    long long _wirelength;
+    int _blockVisited;
+};
+
+#endif
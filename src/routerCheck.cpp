@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include "router.h"
+
+using namespace std;
+
+// Cross-checks the searches that promise a shortest path against the BFS
+// (dijkstra on a Hanan grid) on random boards, and that every path they
+// return is a walk over free cells from the start to the finish.
+
+struct Board {
+    int width, height;
+    double blocked; // share of the cells taken by other nets
+    int searches;
+};
+
+static int failures = 0;
+
+static const char *modeName(SearchMode mode) {
+    static const char *names[] = {"BFS", "ASTAR", "BIDIRECTIONAL", "BITWAVE", "LINEPROBE", "CONGESTION", "WINDOWED", "PARALLEL"};
+    return names[mode];
+}
+
+// the last path of router leads from start to finish one track at a time over free cells
+static bool walks(const StateGrid &grid, const RouterContext &router, Position start, Position finish) {
+    const vector<Position> &path = router.path();
+    int length = router.pathLength();
+    if ((int) path.size() != length + 1 || !(path[length] == start) || !(path[length - 1] == finish)) return false;
+    Position here = start;
+    for (int i = 0; i < length; ++i) {
+        if (abs(path[i].row - here.row) + abs(path[i].col - here.col) != 1) return false;
+        if (!cell_routable(grid(path[i].row, path[i].col))) return false;
+        here = path[i];
+    }
+    return true;
+}
+
+static void check(const StateGrid &grid, const HananAxes &axes, RouterContext &router, Position start, Position finish,
+                  SearchMode mode, bool shortest, long long length) {
+    bool found = router.findPath(grid, axes, start, finish, mode);
+    if (found != shortest || (found && (router.wirelength() != length || !walks(grid, router, start, finish)))) {
+        printf("%s: (%d, %d) to (%d, %d) on a %dx%d grid gave %lld, the BFS %lld\n", modeName(mode),
+               start.row, start.col, finish.row, finish.col, grid.width(), grid.height(),
+               found ? router.wirelength() : -1, shortest ? length : -1);
+        ++failures;
+    }
+}
+
+static Position freeCell(const StateGrid &grid, mt19937 &random) {
+    while (true) {
+        Position p(random() % grid.width(), random() % grid.height());
+        if (cell_routable(grid(p.row, p.col))) return p;
+    }
+}
+
+static void checkBoard(const Board &board, const HananAxes &axes, const vector<SearchMode> &modes, mt19937 &random) {
+    StateGrid grid(axes.width(), axes.height());
+    bernoulli_distribution taken(board.blocked);
+    for (int y = 0; y < grid.height(); ++y) {
+        for (int x = 0; x < grid.width(); ++x) grid(x, y) = taken(random) ? CELL_OTHER_NET : CELL_EMPTY;
+    }
+    RouterContext bfs, router;
+    router.setThreads(4);
+    for (int i = 0; i < board.searches; ++i) {
+        Position start = freeCell(grid, random), finish = freeCell(grid, random);
+        if (start == finish) continue;
+        bool shortest = bfs.findPath(grid, axes, start, finish, SEARCH_BFS);
+        if (shortest && !walks(grid, bfs, start, finish)) {
+            printf("BFS: (%d, %d) to (%d, %d) is no path\n", start.row, start.col, finish.row, finish.col);
+            ++failures;
+        }
+        for (SearchMode mode: modes) check(grid, axes, router, start, finish, mode, shortest, bfs.wirelength());
+    }
+}
+
+int main() {
+    mt19937 random(20240521);
+    // the last boards are large enough for the parallel wave to spread its levels over the threads
+    const Board unitBoards[] = {{8, 8, 0.2, 200}, {40, 30, 0.3, 200}, {150, 100, 0.35, 100},
+                                {600, 400, 0.25, 20}, {1500, 1500, 0.1, 4}};
+    const vector<SearchMode> unitModes = {SEARCH_ASTAR, SEARCH_BIDIRECTIONAL, SEARCH_BITWAVE, SEARCH_WINDOWED, SEARCH_PARALLEL};
+    for (const Board &board: unitBoards) {
+        HananAxes axes;
+        axes.build_unit(board.width, board.height);
+        checkBoard(board, axes, unitModes, random);
+    }
+    // tracks on random coordinates of a large board, steps cost the real distance
+    const Board hananBoards[] = {{100000, 100000, 0.2, 100}, {1000000, 50000, 0.3, 50}};
+    const vector<SearchMode> hananModes = {SEARCH_ASTAR, SEARCH_WINDOWED};
+    for (const Board &board: hananBoards) {
+        vector<int> xs, ys;
+        for (int i = 0; i < 60; ++i) {
+            xs.push_back(random() % board.width);
+            ys.push_back(random() % board.height);
+        }
+        sort(xs.begin(), xs.end());
+        xs.erase(unique(xs.begin(), xs.end()), xs.end());
+        sort(ys.begin(), ys.end());
+        ys.erase(unique(ys.begin(), ys.end()), ys.end());
+        HananAxes axes;
+        axes.build_compressed(xs, ys, board.width, board.height);
+        checkBoard(board, axes, hananModes, random);
+    }
+    if (failures > 0) {
+        printf("%d searches disagree with the BFS\n", failures);
+        return 1;
+    }
+    printf("every search agrees with the BFS\n");
+    return 0;
+}
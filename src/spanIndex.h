@@ -0,0 +1,125 @@
+#ifndef _SPANINDEX_H
+#define _SPANINDEX_H
+
+#include <vector>
+#include <algorithm>
+#include "findPath.h"
+
+// Set of grid cells kept as the runs of consecutive cells along every row
+// and every column, so the far end of the run through a cell, or the next
+// cell of the set along a line, is a binary search instead of a walk. It is
+// built for one tree at a time and only grows while that tree is repaired.
+class SpanIndex {
+public:
+    SpanIndex() {}
+
+    ~SpanIndex() {}
+
+    // the given cells of a width x height grid, duplicates are fine
+    void build(int width, int height, std::vector<Position> cells) {
+        _rows.assign(height, std::vector<Run>());
+        _cols.assign(width, std::vector<Run>());
+        // by y then x gives the runs of every row in order, by x then y those of every column
+        std::sort(cells.begin(), cells.end(), [](const Position &a, const Position &b) {
+            return a.col != b.col ? a.col < b.col : a.row < b.row;
+        });
+        for (auto &p: cells) append(_rows[p.col], p.row);
+        std::sort(cells.begin(), cells.end(), [](const Position &a, const Position &b) {
+            return a.row != b.row ? a.row < b.row : a.col < b.col;
+        });
+        for (auto &p: cells) append(_cols[p.row], p.col);
+    }
+
+    int width() const {
+        return _cols.size();
+    }
+
+    int height() const {
+        return _rows.size();
+    }
+
+    bool contains(int x, int y) const {
+        return find(_rows[y], x) != _rows[y].end();
+    }
+
+    void insert(int x, int y) {
+        add(_rows[y], x);
+        add(_cols[x], y);
+    }
+
+    // last cell of the run through (x, y) going by the unit step (dx, dy), (x, y) has to be in the set;
+    // the coordinate along the line, x for a step along x and y otherwise
+    int runEnd(int x, int y, int dx, int dy) const {
+        const std::vector<Run> &line = dx ? _rows[y] : _cols[x];
+        std::vector<Run>::const_iterator run = find(line, dx ? x : y);
+        return dx + dy > 0 ? run->hi : run->lo;
+    }
+
+    // nearest cell of the set from (x, y) on going by the unit step (dx, dy), (x, y) included;
+    // the coordinate along the line, or -1 when there is none
+    int next(int x, int y, int dx, int dy) const {
+        const std::vector<Run> &line = dx ? _rows[y] : _cols[x];
+        int c = dx ? x : y;
+        std::vector<Run>::const_iterator run = first_after(line, c);
+        if (dx + dy > 0) {
+            if (run != line.begin() && (run - 1)->hi >= c) return c;
+            return run == line.end() ? -1 : run->lo;
+        }
+        if (run == line.begin()) return -1;
+        --run;
+        return std::min(run->hi, c);
+    }
+
+private:
+    // inclusive run of coordinates along a line
+    struct Run {
+        int lo, hi;
+    };
+
+    // first run starting after c
+    static std::vector<Run>::const_iterator first_after(const std::vector<Run> &line, int c) {
+        return std::upper_bound(line.begin(), line.end(), c, [](int v, const Run &r) { return v < r.lo; });
+    }
+
+    static std::vector<Run>::iterator first_after(std::vector<Run> &line, int c) {
+        return std::upper_bound(line.begin(), line.end(), c, [](int v, const Run &r) { return v < r.lo; });
+    }
+
+    // run holding c, or end
+    static std::vector<Run>::const_iterator find(const std::vector<Run> &line, int c) {
+        std::vector<Run>::const_iterator run = first_after(line, c);
+        if (run == line.begin() || (run - 1)->hi < c) return line.end();
+        return run - 1;
+    }
+
+    // c not below the last run of line
+    static void append(std::vector<Run> &line, int c) {
+        if (!line.empty() && line.back().hi >= c - 1) {
+            line.back().hi = std::max(line.back().hi, c);
+        } else {
+            line.push_back(Run{c, c});
+        }
+    }
+
+    static void add(std::vector<Run> &line, int c) {
+        std::vector<Run>::iterator after = first_after(line, c);
+        bool joinsBefore = after != line.begin() && (after - 1)->hi >= c - 1;
+        bool joinsAfter = after != line.end() && after->lo == c + 1;
+        if (joinsBefore && (after - 1)->hi >= c) return;
+        if (joinsBefore && joinsAfter) {
+            (after - 1)->hi = after->hi;
+            line.erase(after);
+        } else if (joinsBefore) {
+            (after - 1)->hi = c;
+        } else if (joinsAfter) {
+            after->lo = c;
+        } else {
+            line.insert(after, Run{c, c});
+        }
+    }
+
+    std::vector<std::vector<Run>> _rows; // runs along x of every y
+    std::vector<std::vector<Run>> _cols; // runs along y of every x
+};
+
+#endif
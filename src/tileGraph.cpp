@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <functional>
+#include "tileGraph.h"
+
+using namespace std;
+
+void TileGraph::build(const StateGrid &grid, int tileSize) {
+    _tileSize = tileSize;
+    _cellsWidth = grid.width();
+    _cellsHeight = grid.height();
+    int width = (grid.width() + tileSize - 1) / tileSize;
+    int height = (grid.height() + tileSize - 1) / tileSize;
+    _free = Grid<uint32_t>(width, height);
+    _passX = Grid<uint32_t>(width, height);
+    _passY = Grid<uint32_t>(width, height);
+    for (int y = 0; y < grid.height(); ++y) {
+        const uint8_t *cells = grid.row(y);
+        const uint8_t *below = y + 1 < grid.height() ? grid.row(y + 1) : nullptr;
+        bool border = (y + 1) % tileSize == 0 && below;
+        for (int x = 0; x < grid.width(); ++x) {
+            if (!cell_routable(cells[x])) continue;
+            int tx = x / tileSize, ty = y / tileSize;
+            ++_free(tx, ty);
+            if ((x + 1) % tileSize == 0 && x + 1 < grid.width() && cell_routable(cells[x + 1])) ++_passX(tx, ty);
+            if (border && cell_routable(below[x])) ++_passY(tx, ty);
+        }
+    }
+}
+
+long long TileGraph::stepCost(int x, int y, uint32_t pass) const {
+    // a tile is crossed in about tileSize steps, more when it is crowded
+    // or the border into it is narrow
+    long long cellsX = min(_tileSize, _cellsWidth - x * _tileSize);
+    long long cellsY = min(_tileSize, _cellsHeight - y * _tileSize);
+    long long cells = cellsX * cellsY;
+    return _tileSize + _tileSize * (cells - _free(x, y)) / cells + _tileSize * (_tileSize - min<long long>(pass, _tileSize)) / _tileSize;
+}
+
+bool TileGraph::route(const vector<Position> &sources, const vector<Position> &sinks, int halo, Grid<uint8_t> &corridor) {
+    int width = _free.width();
+    size_t tiles = (size_t) width * _free.height();
+    _dist.assign(tiles, INT64_MAX);
+    _from.assign(tiles, -1);
+    _sink.assign(tiles, 0);
+    _heap.clear();
+    typedef pair<long long, int> Entry;
+    greater<Entry> later;
+    for (auto &p: sinks) _sink[(size_t) (p.col / _tileSize) * width + p.row / _tileSize] = 1;
+    for (auto &p: sources) {
+        int tile = (p.col / _tileSize) * width + p.row / _tileSize;
+        if (_dist[tile] == 0) continue;
+        _dist[tile] = 0;
+        _heap.emplace_back(0, tile);
+    }
+    make_heap(_heap.begin(), _heap.end(), later);
+    int reached = -1;
+    while (!_heap.empty()) {
+        pop_heap(_heap.begin(), _heap.end(), later);
+        Entry top = _heap.back();
+        _heap.pop_back();
+        if (top.first > _dist[top.second]) continue;
+        if (_sink[top.second]) {
+            reached = top.second;
+            break;
+        }
+        int x = top.second % width, y = top.second / width;
+        // right, down, left, up, each with the border crossed
+        const int dx[4] = {1, 0, -1, 0}, dy[4] = {0, 1, 0, -1};
+        for (int i = 0; i < 4; ++i) {
+            int nx = x + dx[i], ny = y + dy[i];
+            if (!_free.inside(nx, ny) || _free(nx, ny) == 0) continue;
+            uint32_t pass = dx[i] ? _passX(min(x, nx), y) : _passY(x, min(y, ny));
+            if (pass == 0) continue;
+            long long d = top.first + stepCost(nx, ny, pass);
+            int tile = ny * width + nx;
+            if (d < _dist[tile]) {
+                _dist[tile] = d;
+                _from[tile] = top.second;
+                _heap.emplace_back(d, tile);
+                push_heap(_heap.begin(), _heap.end(), later);
+            }
+        }
+    }
+    if (reached < 0) return false;
+    if (corridor.width() != width || corridor.height() != _free.height()) corridor = Grid<uint8_t>(width, _free.height());
+    else corridor.fill(0);
+    for (int tile = reached; tile >= 0; tile = _from[tile]) {
+        int x = tile % width, y = tile / width;
+        for (int j = max(y - halo, 0); j <= min(y + halo, _free.height() - 1); ++j) {
+            for (int i = max(x - halo, 0); i <= min(x + halo, width - 1); ++i) corridor(i, j) = 1;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef _TILEGRAPH_H
+#define _TILEGRAPH_H
+
+#include <vector>
+#include <utility>
+#include "findPath.h"
+#include "grid.h"
+
+// boards with more cells than this reconnect far islands through a tile corridor
+const long long TILED_ROUTING_CELLS = 1LL << 22;
+
+// Coarse view of a routing grid for global routing: square tiles of
+// tileSize cells, each with the number of routable cells it holds and the
+// number of places its right and lower borders can be crossed. A route is
+// first found from tile to tile, preferring free tiles and wide borders,
+// and the tiles it takes become the corridor the detailed search runs in.
+class TileGraph {
+public:
+    TileGraph() : _tileSize(0) {}
+
+    ~TileGraph() {}
+
+    // counts the routable cells and border crossings of every tile of grid
+    void build(const StateGrid &grid, int tileSize);
+
+    int tileSize() const {
+        return _tileSize;
+    }
+
+    // size of the board in tiles
+    int width() const {
+        return _free.width();
+    }
+
+    int height() const {
+        return _free.height();
+    }
+
+    // cheapest chain of tiles from a tile of a source to a tile of a sink; corridor
+    // gets one byte per tile, 1 on the chain and within halo tiles of it.
+    // False when no chain of crossable borders joins them
+    bool route(const std::vector<Position> &sources, const std::vector<Position> &sinks, int halo, Grid<uint8_t> &corridor);
+
+private:
+    // cost of stepping into tile (x, y) over a border with pass crossings
+    long long stepCost(int x, int y, uint32_t pass) const;
+
+    int _tileSize;
+    int _cellsWidth, _cellsHeight;
+    Grid<uint32_t> _free;  // routable cells of every tile
+    Grid<uint32_t> _passX; // crossings of the border between tile (x, y) and (x + 1, y)
+    Grid<uint32_t> _passY; // crossings of the border between tile (x, y) and (x, y + 1)
+    // search buffers, kept between routes
+    std::vector<long long> _dist;
+    std::vector<int> _from;
+    std::vector<uint8_t> _sink;
+    std::vector<std::pair<long long, int>> _heap;
+};
+
+#endif
@@ -11,6 +11,8 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <limits> // numeric_limits
+#include <string>
+#include <cstring> // memcpy, strlen
 
 constexpr double TIME_SCALE = 1000000.0;
 constexpr double MEMORY_SCALE = 1024.0;
@@ -78,7 +80,7 @@ private:
 inline double getPeakMemoryUsage() {
 #if defined(linux)
     char buf[1000];
-    ifstream ifs("/proc/self/stat");
+    std::ifstream ifs("/proc/self/stat");
     for(int i = 0; i!= 23; ++i) ifs >> buf;
     return (1.0 / (MEMORY_SCALE * MEMORY_SCALE) * atof(buf)); // GB
 #else
@@ -86,4 +88,79 @@ inline double getPeakMemoryUsage() {
 #endif
 }
 
-#endif
\ No newline at end of file
+// Output kept in one large buffer and handed to the file in big blocks;
+// integers are formatted by hand instead of through the stream
+class BufferedWriter {
+public:
+    explicit BufferedWriter(const std::string &fileName, bool binary = false)
+            : _own(fileName, binary ? std::ios::out | std::ios::binary : std::ios::out), _file(_own) {
+        _buffer.reserve(BLOCK);
+    }
+
+    // appends to a stream that is already open, everything is in it once the writer is gone
+    explicit BufferedWriter(std::ostream &file) : _file(file) {
+        _buffer.reserve(BLOCK);
+    }
+
+    ~BufferedWriter() {
+        flush();
+    }
+
+    BufferedWriter &put(const char *text) {
+        return write(text, strlen(text));
+    }
+
+    BufferedWriter &put(const std::string &text) {
+        return write(text.data(), text.size());
+    }
+
+    BufferedWriter &put(char c) {
+        if (_buffer.size() >= BLOCK) flush();
+        _buffer.push_back(c);
+        return *this;
+    }
+
+    // decimal text of value
+    BufferedWriter &put(long long value) {
+        char digits[24];
+        int n = 0;
+        unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long) value : value;
+        do {
+            digits[n++] = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0) digits[n++] = '-';
+        if (_buffer.size() + n > BLOCK) flush();
+        while (n > 0) _buffer.push_back(digits[--n]);
+        return *this;
+    }
+
+    BufferedWriter &put(int value) {
+        return put((long long) value);
+    }
+
+    // raw bytes, for binary files
+    BufferedWriter &write(const void *data, size_t size) {
+        if (_buffer.size() + size > BLOCK) flush();
+        if (size > BLOCK) {
+            _file.write((const char *) data, size);
+        } else {
+            _buffer.insert(_buffer.end(), (const char *) data, (const char *) data + size);
+        }
+        return *this;
+    }
+
+    void flush() {
+        _file.write(_buffer.data(), _buffer.size());
+        _buffer.clear();
+        _file.flush();
+    }
+
+private:
+    static const size_t BLOCK = 1 << 20;
+    std::ofstream _own;
+    std::ostream &_file;
+    std::vector<char> _buffer;
+};
+
+#endif